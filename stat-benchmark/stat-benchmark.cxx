@@ -24,7 +24,58 @@
 #  include <dirent.h>    // struct dirent, *dir()
 #  include <sys/time.h>  // utimes()
 #  include <sys/types.h> // stat
-#  include <sys/stat.h>  // stat()
+#  include <sys/stat.h>  // stat(), statx()
+#  include <fcntl.h>     // open(), openat(), AT_*
+#  include <unistd.h>    // close(), syscall()
+#  include <sys/mman.h>  // mmap()
+#  include <sys/resource.h> // getrusage()
+#  include <sys/uio.h>   // writev()
+#endif
+
+#ifdef __linux__
+#  include <sched.h>       // sched_setaffinity(), sched_setscheduler()
+#  include <sys/syscall.h> // SYS_getdents64
+#  include <sys/vfs.h>     // statfs()
+#endif
+
+#ifndef _WIN32
+#  include <sys/utsname.h> // uname()
+#  if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || \
+      defined(__OpenBSD__)
+#    include <sys/mount.h> // statfs()
+#  endif
+#endif
+
+// Note that statx() is only available on Linux with glibc 2.28 or later.
+//
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+#  define STAT_BENCHMARK_STATX
+#endif
+
+// Note that we only support reading the time stamp counter on x86 with
+// GCC-compatible compilers.
+//
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  include <cpuid.h>     // __get_cpuid()
+#  include <x86intrin.h> // __rdtscp()
+#  define STAT_BENCHMARK_TSC
+#endif
+
+// Note that we use io_uring directly via the syscalls rather than via
+// liburing.
+//
+#if defined(STAT_BENCHMARK_STATX) && __has_include(<linux/io_uring.h>)
+#  include <linux/io_uring.h>
+#  define STAT_BENCHMARK_IO_URING
+#endif
+
+// Note that we use perf_event_open() directly via the syscall rather than
+// via libpfm or similar.
+//
+#if defined(__linux__) && __has_include(<linux/perf_event.h>)
+#  include <sys/ioctl.h>        // ioctl()
+#  include <linux/perf_event.h>
+#  define STAT_BENCHMARK_PERF
 #endif
 
 #ifdef _WIN32
@@ -35,12 +86,33 @@
 
 #include <ctime>        // tm, time_t, strftime()[libstdc++]
 #include <cerrno>
+#include <cstdint>      // uint64_t
 #include <vector>
 #include <chrono>
 #include <memory>
 #include <string>
 #include <utility>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <optional>
+#include <exception>
+#include <string_view>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <cmath>        // sqrt(), llround()
+#include <algorithm>    // sort()
+#include <array>
+#include <bit>          // bit_width()
+#include <sstream>
+#include <cstdio>       // sscanf()
+#include <charconv>     // to_chars()
 #include <cstring>      // memcpy()
+#include <cstdlib>      // malloc(), free()
+#include <new>          // bad_alloc
 #include <ostream>
 #include <cassert>
 #include <fstream>
@@ -254,6 +326,7 @@ operator!= (const auto_handle& x, nullhandle_t y)
 // timestamp
 //
 using std::chrono::system_clock;
+using std::chrono::steady_clock;
 using std::chrono::nanoseconds;
 using std::chrono::duration_cast;
 
@@ -498,6 +571,156 @@ operator<< (std::ostream& os, const timestamp& ts)
   return to_stream (os, ts, "%Y-%m-%d %H:%M:%S%[.N]", true, true);
 }
 
+// Fast formatter for the default timestamp format (see operator<< above),
+// producing the same output as to_stream() but writing the characters
+// directly into the buffer.
+//
+// The local date, hour, and minute (YYYY-MM-DD HH:MM:) are cached per UTC
+// minute, so localtime() is only called for the first timestamp in each
+// minute encountered, with the seconds calculated from the offset within
+// the minute. The cache is direct-mapped by the minute (rather than holding
+// the last one only) since the modification and access times are normally
+// formatted interleaved and tend to be far apart.
+//
+// When filling the cache entry the local time is obtained for both the
+// first and the last second of the minute and if they are not 59 seconds
+// apart within the same local minute (the local time offset changes in the
+// middle of this minute or is not a whole number of minutes, as some of
+// the historical offsets, or there is a leap second), then the timestamp
+// is formatted with to_stream(). Also note that the time zone is only read
+// once (on the first localtime() call) and the timestamps before the epoch
+// are formatted with to_stream() as well.
+//
+class timestamp_formatter
+{
+public:
+  // The maximum formatted timestamp length.
+  //
+  static constexpr size_t capacity = 64;
+
+  // Format the timestamp into the buffer of at least capacity characters
+  // and return the number of characters written (not NUL-terminated).
+  //
+  size_t
+  format (const timestamp& ts, char* b)
+  {
+    if (ts == timestamp_unknown)     return copy ("<unknown>", b);
+    if (ts == timestamp_nonexistent) return copy ("<nonexistent>", b);
+    if (ts == timestamp_unreal)      return copy ("<unreal>", b);
+
+    time_t t (system_clock::to_time_t (ts));
+    nanoseconds ns (
+      duration_cast<nanoseconds> (ts - system_clock::from_time_t (t)));
+
+    if (t < 0 || ns.count () < 0)
+      return format_slow (ts, b);
+
+    time_t m (t - t % 60);
+    entry& e (cache_[(m / 60) % cache_size]);
+
+    if (!e.valid || e.start != m)
+    {
+      std::tm tm (local (m));
+      std::tm le (local (m + 59));
+
+      // Bail out on the years that don't fit the cached prefix width as
+      // well as on the minutes that don't map to a single local minute (see
+      // above for details).
+      //
+      if (tm.tm_year + 1900 > 9999 ||
+          tm.tm_sec != 0           ||
+          le.tm_sec != 59          ||
+          le.tm_min != tm.tm_min   ||
+          le.tm_hour != tm.tm_hour ||
+          le.tm_mday != tm.tm_mday ||
+          le.tm_mon != tm.tm_mon   ||
+          le.tm_year != tm.tm_year)
+        return format_slow (ts, b);
+
+      char* p (e.prefix);
+      p = digits (p, tm.tm_year + 1900, 4); *p++ = '-';
+      p = digits (p, tm.tm_mon + 1, 2);     *p++ = '-';
+      p = digits (p, tm.tm_mday, 2);        *p++ = ' ';
+      p = digits (p, tm.tm_hour, 2);        *p++ = ':';
+      p = digits (p, tm.tm_min, 2);         *p++ = ':';
+
+      e.start = m;
+      e.valid = true;
+    }
+
+    char* p (b);
+
+    memcpy (p, e.prefix, sizeof (e.prefix));
+    p += sizeof (e.prefix);
+
+    p = digits (p, static_cast<unsigned> (t - e.start), 2);
+
+    if (ns.count () != 0)
+    {
+      *p++ = '.';
+      p = digits (p, static_cast<unsigned> (ns.count ()), 9);
+    }
+
+    return p - b;
+  }
+
+private:
+  static std::tm
+  local (time_t t)
+  {
+    std::tm r;
+    if (details::localtime (&t, &r) == nullptr)
+    {
+      cerr << "error: localtime() failed: " << last_errno_msg () << endl;
+      throw failed ();
+    }
+
+    return r;
+  }
+
+  static size_t
+  copy (const char* s, char* b)
+  {
+    size_t n (strlen (s));
+    memcpy (b, s, n);
+    return n;
+  }
+
+  // Write the value as the specified number of digits, zero-padded.
+  //
+  static char*
+  digits (char* p, unsigned v, size_t n)
+  {
+    for (size_t i (n); i != 0; --i, v /= 10)
+      p[i - 1] = static_cast<char> ('0' + v % 10);
+
+    return p + n;
+  }
+
+  static size_t
+  format_slow (const timestamp& ts, char* b)
+  {
+    ostringstream os;
+    os << ts;
+
+    string s (os.str ());
+    size_t n (min (s.size (), capacity));
+    memcpy (b, s.data (), n);
+    return n;
+  }
+
+  static constexpr size_t cache_size = 64;
+
+  struct entry
+  {
+    bool valid = false;
+    time_t start;    // UTC minute start.
+    char prefix[17]; // YYYY-MM-DD HH:MM:
+  };
+
+  entry cache_[cache_size];
+};
+
 template<class R, class P>
 static ostream&
 to_stream (ostream& os, const std::chrono::duration<R, P>& d, bool ns)
@@ -611,832 +834,7254 @@ struct entry_time
   timestamp access;
 };
 
-// Usages:
-//
-//  Windows:
-//    argv[0] stat (-a|-e|-h) [-r] <file>
-//    argv[0] iter (-p|-n|-N) [-a|-e|-h] [-P <level>] [-r] <dir>
-//
-//  POSIX:
-//    argv[0] stat -s [-r] <file>
-//    argv[0] iter -o [-s] [-P <level>] [-r] <dir>
-//
-//  Common:
-//    argv[0] avg <sum> <count>
-//
-// In the first form reads the specified file containing filesystem entry
-// paths, one per line. Stat each path, retrieving the entry modification and
-// access times, using the specified stat method, and print the retrieval
-// statistics to stderr.
-//
-// In the second form iterate through the sub-entries of the specified
-// directory, recursively. Optionally, stat each path. Print the traversal
-// statistics to stderr.
-//
-// In the third form calculate the average (<sum> / <count>) and print the
-// result to stdout.
-//
-// -a
-//    Use GetFileAttributesA() to stat the filesystem entries (note:
-//    modification and access times are not retrieved).
-//
-// -e
-//    Use GetFileAttributesExA() to stat the filesystem entries.
-//
-// -h
-//    Use CreateFile() and GetFileInformationByHandle() to stat the filesystem
-//    entries.
-//
-// -s
-//    Use stat() to stat the filesystem entries.
-//
-// -p
-//    Use _findfirst() and _findnext() to traverse the directory.
-//
-// -n
-//    Use FindFirstFileA() and FindNextFileA() to traverse the directory.
-//
-// -N
-//    Use FindFirstFileExA() and FindNextFileA() to traverse the directory.
-//
-// -o
-//    Use opendir() and readdir() to traverse the directory.
-//
-// -r
-//    Print the average time in nanoseconds spent on the processing of a
-//    filesystem entry to stdout.
+// Additional entry information (see iter --snapshot for details). Zero if
+// unknown.
 //
-// -P <level>
-//    If level is not 0, then print the entry paths one per line, optionally
-//    together with their modification/access time (level > 1) to stdout.
+struct entry_info
+{
+  uint64_t ino = 0;
+  uint64_t size = 0;
+  uint32_t mode = 0; // Type and permissions (st_mode).
+};
+
+#ifdef STAT_BENCHMARK_STATX
+// Parse the comma-separated list of the statx() field names and flags (see
+// --mask for details). Return false if the list is invalid.
 //
-int
-main (int argc, char* argv[])
+static bool
+parse_statx_mask (const string& s, unsigned int& mask, int& flags)
 {
-  auto usage = [&argv] ()
+  mask = 0;
+  flags = 0;
+
+  for (size_t b (0), e; b <= s.size (); b = e + 1)
   {
-    cerr << "Usage:" << endl
-#ifdef _WIN32
-         << "  " << argv[0] << " stat (-a|-e|-h) [-r] <file>" << endl
-         << "  " << argv[0] << " iter (-p|-n|-N) [-a|-e|-h] [-P <level>] [-r] <dir>"
-         << endl
-#else
-         << "  " << argv[0] << " stat -s [-r] <file>" << endl
-         << "  " << argv[0] << " iter -o [-s] [-P <level>] [-r] <dir>" << endl
+    e = s.find (',', b);
+    if (e == string::npos)
+      e = s.size ();
+
+    string n (s, b, e - b);
+
+    if      (n == "type")       mask |= STATX_TYPE;
+    else if (n == "mode")       mask |= STATX_MODE;
+    else if (n == "nlink")      mask |= STATX_NLINK;
+    else if (n == "uid")        mask |= STATX_UID;
+    else if (n == "gid")        mask |= STATX_GID;
+    else if (n == "atime")      mask |= STATX_ATIME;
+    else if (n == "mtime")      mask |= STATX_MTIME;
+    else if (n == "ctime")      mask |= STATX_CTIME;
+    else if (n == "ino")        mask |= STATX_INO;
+    else if (n == "size")       mask |= STATX_SIZE;
+    else if (n == "blocks")     mask |= STATX_BLOCKS;
+    else if (n == "btime")      mask |= STATX_BTIME;
+    else if (n == "basic")      mask |= STATX_BASIC_STATS;
+    else if (n == "dont-sync")  flags |= AT_STATX_DONT_SYNC;
+    else if (n == "force-sync") flags |= AT_STATX_FORCE_SYNC;
+    else
+      return false;
+  }
+
+  // The sync flags are mutually exclusive.
+  //
+  return (flags & (AT_STATX_DONT_SYNC | AT_STATX_FORCE_SYNC)) !=
+         (AT_STATX_DONT_SYNC | AT_STATX_FORCE_SYNC);
+}
 #endif
-         << "  " << argv[0] << " avg <sum> <count>" << endl;
 
-    throw failed ();
-  };
+#ifndef _WIN32
+// List of entry paths, one per line, loaded from a file without copying.
+//
+// The file is mapped into memory privately (copy-on-write) and the newlines
+// are replaced with the NUL characters in place, so that each path can be
+// passed to the system calls directly. Note that the mapping is one byte
+// larger than the file to accommodate the terminating NUL character for the
+// last path if the file doesn't end with a newline.
+//
+class path_list
+{
+public:
+  explicit
+  path_list (const string& file);
 
-  try
+  ~path_list ()
   {
-    int i (1);
+    if (data_ != nullptr)
+      munmap (data_, capacity_);
+  }
 
-    if (argc == 1)
-      usage ();
+  path_list (const path_list&) = delete;
+  path_list& operator= (const path_list&) = delete;
 
-    enum class cmd
-    {
-      stat,
-      iter,
-      avg,
-      none
-    } c (cmd::none);
+  // Note that each path is NUL-terminated (p.data ()[p.size ()] == '\0').
+  //
+  const vector<string_view>&
+  paths () const {return paths_;}
 
-    string a (argv[i++]);
+private:
+  char* data_ = nullptr;
+  size_t capacity_ = 0;
+  vector<string_view> paths_;
+};
 
-    if (a == "stat")
-      c = cmd::stat;
-    else if (a == "iter")
-      c = cmd::iter;
-    else if (a == "avg")
-      c = cmd::avg;
-    else
-      usage ();
+path_list::
+path_list (const string& file)
+{
+  int fd (open (file.c_str (), O_RDONLY | O_CLOEXEC));
 
-    if (c == cmd::avg)
-    {
-      if (argc != 4)
-        usage ();
+  if (fd == -1)
+  {
+    cerr << "error: can't open " << file << ": " << last_errno_msg ()
+         << endl;
+    throw failed ();
+  }
 
-      cout << stoul (argv[i]) / stoul (argv[i + 1]) << endl;
-      return 0;
-    }
+  struct stat s;
+  if (fstat (fd, &s) != 0)
+  {
+    cerr << "error: can't stat " << file << ": " << last_errno_msg ()
+         << endl;
+    close (fd);
+    throw failed ();
+  }
 
-#ifdef _WIN32
-    enum class cmd_stat
-    {
-      none,
-      attrs,
-      attrs_ex,
-      handle
-    } st (cmd_stat::none);
+  size_t n (static_cast<size_t> (s.st_size));
 
-    enum class cmd_iter
-    {
-      none,
-      native,
-      native_ex,
-      posix
-    } it (cmd_iter::none);
+  // Reserve the address range with an anonymous mapping and then map the
+  // file over its beginning. This way the byte past the end of the file is
+  // always backed by memory, even if the file size is a multiple of the page
+  // size.
+  //
+  capacity_ = n + 1;
 
-    unsigned long print (0);
-    bool print_result (false);
+  void* p (mmap (nullptr,
+                 capacity_,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS,
+                 -1,
+                 0));
 
-    for (; i != argc; ++i)
-    {
-      string v (argv[i]);
+  if (p == MAP_FAILED)
+  {
+    cerr << "error: can't map " << file << ": " << last_errno_msg ()
+         << endl;
+    close (fd);
+    throw failed ();
+  }
 
-      auto sst = [&st, &usage] (cmd_stat v)
-      {
-        if (st != cmd_stat::none)
-          usage ();
+  data_ = static_cast<char*> (p);
 
-        st = v;
-      };
+  if (n != 0 &&
+      mmap (data_,
+            n,
+            PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_FIXED,
+            fd,
+            0) == MAP_FAILED)
+  {
+    cerr << "error: can't map " << file << ": " << last_errno_msg ()
+         << endl;
+    close (fd);
+    throw failed (); // Note: unmapped by the destructor.
+  }
 
-      auto sit = [&it, &usage] (cmd_iter v)
-      {
-        if (it != cmd_iter::none)
-          usage ();
+  close (fd);
 
-        it = v;
-      };
+#ifdef MADV_SEQUENTIAL
+  madvise (data_, n, MADV_SEQUENTIAL);
+#endif
 
-      if (v == "-a")
-        sst (cmd_stat::attrs);
-      else if (v == "-e")
-        sst (cmd_stat::attrs_ex);
-      else if (v == "-h")
-        sst (cmd_stat::handle);
-      else if (v == "-p")
-        sit (cmd_iter::posix);
-      else if (v == "-n")
-        sit (cmd_iter::native);
-      else if (v == "-N")
-        sit (cmd_iter::native_ex);
-      else if (v == "-P")
-      {
-        if (++i == argc)
-          usage ();
+  // Split the lines, similar to getline().
+  //
+  for (char* b (data_), *e (data_ + n); b != e; )
+  {
+    char* l (static_cast<char*> (memchr (b, '\n', e - b)));
 
-        print = stoul (argv[i]);
-      }
-      else if (v == "-r")
-        print_result = true;
-      else
-        break;
-    }
+    if (l == nullptr)
+      l = e;
 
-    auto tm = [] (const FILETIME& t) -> timestamp
-    {
-      // Time in FILETIME is in 100 nanosecond "ticks" since "Windows epoch"
-      // (1601-01-01T00:00:00Z). To convert it to "UNIX epoch"
-      // (1970-01-01T00:00:00Z) we need to subtract 11644473600 seconds.
-      //
-      uint64_t nsec ((static_cast<uint64_t> (t.dwHighDateTime) << 32) |
-                     t.dwLowDateTime);
+    *l = '\0';
+    paths_.emplace_back (b, l - b);
 
-      nsec -= 11644473600ULL * 10000000; // Now in UNIX epoch.
-      nsec *= 100;                       // Now in nanoseconds.
+    b = l != e ? l + 1 : e;
+  }
+}
 
-      return timestamp (
-        chrono::duration_cast<duration> (chrono::nanoseconds (nsec)));
+// Snapshot index of a traversed directory tree (see iter --snapshot for
+// details).
+//
+// The index file consists of the header, followed by the entry records
+// sorted by path, followed by the NUL-terminated entry paths, all in the
+// native byte order. The paths are relative to the traversed directory with
+// the directory itself represented by the empty path. The index is memory
+// mapped for reading and the entries are looked up by path with the binary
+// search.
+//
+class snapshot_index
+{
+public:
+  // Entry to be written.
+  //
+  struct entry
+  {
+    string path;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime; // Nanoseconds since epoch.
+    uint32_t mode;
+  };
+
+  struct record
+  {
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime;
+    uint64_t path; // Path offset in the paths section.
+    uint32_t mode;
+    uint32_t reserved;
+  };
+
+  // Sort the entries and write them into the index file.
+  //
+  static void
+  write (const string& file, vector<entry>&);
+
+  explicit
+  snapshot_index (const string& file);
+
+  ~snapshot_index ()
+  {
+    if (data_ != nullptr)
+      munmap (data_, size_);
+  }
+
+  snapshot_index (const snapshot_index&) = delete;
+  snapshot_index& operator= (const snapshot_index&) = delete;
+
+  size_t
+  size () const {return count_;}
+
+  const record&
+  operator[] (size_t i) const {return records_[i];}
+
+  string_view
+  path (const record& r) const {return string_view (paths_ + r.path);}
+
+  // Return the index of the record with the specified path or size() if not
+  // found.
+  //
+  size_t
+  find (string_view p) const
+  {
+    const record* b (records_);
+    const record* e (records_ + count_);
+
+    const record* i (
+      lower_bound (b, e, p,
+                   [this] (const record& r, string_view p)
+                   {
+                     return path (r) < p;
+                   }));
+
+    return i != e && path (*i) == p ? i - b : count_;
+  }
+
+private:
+  struct header
+  {
+    char magic[8];
+    uint64_t count;
+    uint64_t paths_size;
+  };
+
+  static constexpr char magic[8] {'s', 'b', 'i', 'd', 'x', '\0', '\0', '2'};
+
+  void* data_ = nullptr;
+  size_t size_ = 0;
+
+  const record* records_ = nullptr;
+  size_t count_ = 0;
+  const char* paths_ = nullptr;
+};
+
+void snapshot_index::
+write (const string& file, vector<entry>& es)
+{
+  sort (es.begin (), es.end (),
+        [] (const entry& x, const entry& y) {return x.path < y.path;});
+
+  header h;
+  memcpy (h.magic, magic, sizeof (magic));
+  h.count = es.size ();
+  h.paths_size = 0;
+
+  vector<record> rs;
+  rs.reserve (es.size ());
+
+  for (const entry& e: es)
+  {
+    rs.push_back (record {e.ino, e.size, e.mtime, h.paths_size, e.mode, 0});
+    h.paths_size += e.path.size () + 1;
+  }
+
+  ofstream f (file, ios::binary);
+  if (!f.is_open ())
+  {
+    cerr << "error: can't open " << file << endl;
+    throw failed ();
+  }
+
+  f.write (reinterpret_cast<const char*> (&h), sizeof (h));
+  f.write (reinterpret_cast<const char*> (rs.data ()),
+           rs.size () * sizeof (record));
+
+  for (const entry& e: es)
+    f.write (e.path.c_str (), e.path.size () + 1);
+
+  f.close ();
+
+  if (!f)
+  {
+    cerr << "error: can't write " << file << endl;
+    throw failed ();
+  }
+}
+
+snapshot_index::
+snapshot_index (const string& file)
+{
+  int fd (open (file.c_str (), O_RDONLY | O_CLOEXEC));
+
+  if (fd == -1)
+  {
+    cerr << "error: can't open " << file << ": " << last_errno_msg ()
+         << endl;
+    throw failed ();
+  }
+
+  struct stat s;
+  if (fstat (fd, &s) != 0)
+  {
+    cerr << "error: can't stat " << file << ": " << last_errno_msg ()
+         << endl;
+    close (fd);
+    throw failed ();
+  }
+
+  size_t n (static_cast<size_t> (s.st_size));
+
+  auto invalid = [&file] ()
+  {
+    cerr << "error: invalid snapshot index " << file << endl;
+    throw failed ();
+  };
+
+  if (n < sizeof (header))
+  {
+    close (fd);
+    invalid ();
+  }
+
+  void* p (mmap (nullptr, n, PROT_READ, MAP_PRIVATE, fd, 0));
+  close (fd);
+
+  if (p == MAP_FAILED)
+  {
+    cerr << "error: can't map " << file << ": " << last_errno_msg ()
+         << endl;
+    throw failed ();
+  }
+
+  data_ = p;
+  size_ = n;
+
+  const char* d (static_cast<const char*> (p));
+  const header& h (*static_cast<const header*> (p));
+
+  // Note: unmapped by the destructor on failure.
+  //
+  if (memcmp (h.magic, magic, sizeof (magic)) != 0 ||
+      h.count > (n - sizeof (header)) / sizeof (record) ||
+      h.paths_size != n - sizeof (header) - h.count * sizeof (record) ||
+      (h.paths_size != 0 && d[n - 1] != '\0'))
+    invalid ();
+
+  records_ = reinterpret_cast<const record*> (d + sizeof (header));
+  count_ = h.count;
+  paths_ = d + sizeof (header) + h.count * sizeof (record);
+
+  for (size_t i (0); i != count_; ++i)
+  {
+    if (records_[i].path >= h.paths_size)
+      invalid ();
+  }
+}
+
+// Buffered output to a file descriptor, bypassing iostream (see -P for
+// details).
+//
+// The data is accumulated in a large buffer and written with write(2) when
+// full. The data that doesn't fit into the buffer is written together with
+// the buffer contents with a single writev(2) call, without copying. Note
+// that the buffer must be flushed explicitly.
+//
+class fd_writer
+{
+public:
+  explicit
+  fd_writer (int fd, size_t capacity = 1024 * 1024)
+      : fd_ (fd), buf_ (new char[capacity]), capacity_ (capacity) {}
+
+  void
+  write (const char* s, size_t n)
+  {
+    if (n <= capacity_ - size_)
+    {
+      memcpy (buf_.get () + size_, s, n);
+      size_ += n;
+      return;
+    }
+
+    iovec v[2] {{buf_.get (), size_}, {const_cast<char*> (s), n}};
+    write_all (v, 2);
+    size_ = 0;
+  }
+
+  void
+  write (string_view s) {write (s.data (), s.size ());}
+
+  void
+  put (char c)
+  {
+    if (size_ == capacity_)
+      flush ();
+
+    buf_[size_++] = c;
+  }
+
+  void
+  flush ()
+  {
+    if (size_ != 0)
+    {
+      iovec v {buf_.get (), size_};
+      write_all (&v, 1);
+      size_ = 0;
+    }
+  }
+
+private:
+  void
+  write_all (iovec* v, int n)
+  {
+    while (n != 0)
+    {
+      ssize_t r (writev (fd_, v, n));
+
+      if (r == -1)
+      {
+        if (errno == EINTR)
+          continue;
+
+        cerr << "error: unable to write output: " << last_errno_msg ()
+             << endl;
+        throw failed ();
+      }
+
+      // Skip the written data, handling the partial writes.
+      //
+      for (size_t c (static_cast<size_t> (r)); n != 0; ++v, --n)
+      {
+        if (c < v->iov_len)
+        {
+          v->iov_base = static_cast<char*> (v->iov_base) + c;
+          v->iov_len -= c;
+          break;
+        }
+
+        c -= v->iov_len;
+      }
+    }
+  }
+
+  int fd_;
+  unique_ptr<char[]> buf_;
+  size_t capacity_;
+  size_t size_ = 0;
+};
+
+// Return the peak resident set size of the process in bytes.
+//
+static uint64_t
+peak_rss ()
+{
+  rusage u;
+  if (getrusage (RUSAGE_SELF, &u) != 0)
+    return 0;
+
+#ifdef __APPLE__
+  return static_cast<uint64_t> (u.ru_maxrss);        // Bytes.
+#else
+  return static_cast<uint64_t> (u.ru_maxrss) * 1024; // Kilobytes.
+#endif
+}
+
+// Resource usage accumulated over the measured runs (see getrusage()).
+//
+struct usage_counters
+{
+  nanoseconds user {0};
+  nanoseconds system {0};
+  uint64_t voluntary_switches = 0;
+  uint64_t involuntary_switches = 0;
+  uint64_t major_faults = 0;
+  uint64_t minor_faults = 0;
+
+  // Add the usage difference between the two getrusage() calls.
+  //
+  void
+  add (const rusage& b, const rusage& e)
+  {
+    auto ns = [] (const timeval& t)
+    {
+      return nanoseconds (static_cast<int64_t> (t.tv_sec) * 1000000000 +
+                          static_cast<int64_t> (t.tv_usec) * 1000);
+    };
+
+    user += ns (e.ru_utime) - ns (b.ru_utime);
+    system += ns (e.ru_stime) - ns (b.ru_stime);
+    voluntary_switches += e.ru_nvcsw - b.ru_nvcsw;
+    involuntary_switches += e.ru_nivcsw - b.ru_nivcsw;
+    major_faults += e.ru_majflt - b.ru_majflt;
+    minor_faults += e.ru_minflt - b.ru_minflt;
+  }
+};
+
+// Return the resource usage of the process, including all its threads.
+//
+static rusage
+process_usage ()
+{
+  rusage u;
+  if (getrusage (RUSAGE_SELF, &u) != 0)
+  {
+    cerr << "error: getrusage() failed: " << last_errno_msg () << endl;
+    throw failed ();
+  }
+
+  return u;
+}
+
+static usage_counters usage_collected;
+
+// Drop the clean page cache as well as the dentry and inode caches
+// system-wide by writing to /proc/sys/vm/drop_caches, flushing the dirty data
+// first (Linux only, requires root; see --cold).
+//
+static void
+drop_caches ()
+{
+  sync ();
+
+  int fd (open ("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC));
+
+  if (fd == -1 || write (fd, "3\n", 2) != 2)
+  {
+    int e (errno);
+
+    if (fd != -1)
+      close (fd);
+
+    cerr << "error: unable to drop caches: " << errno_msg (e) << endl;
+    throw failed ();
+  }
+
+  close (fd);
+}
+
+// Advise the kernel to drop the cached pages of the file referred to by the
+// descriptor (see --cold).
+//
+static inline void
+fadvise_dontneed (int fd)
+{
+#ifdef POSIX_FADV_DONTNEED
+  posix_fadvise (fd, 0, 0, POSIX_FADV_DONTNEED);
+#else
+  (void) fd;
+#endif
+}
+
+// Evict the cached pages of the entry p, which, unless dfd is AT_FDCWD, is
+// relative to the directory referred to by the file descriptor. If the
+// entry type is known (as returned by readdir()), then it can be passed to
+// save the stat() call. Note that this is the best effort: the entries that
+// can't be opened (no permissions, etc) are skipped.
+//
+// Also note that only the regular files and directories are opened since
+// opening the other entries may have side effects (think of a tape device
+// or a FIFO). For the same reason the symlinks are not followed.
+//
+static void
+evict_entry (int dfd, const char* p, unsigned char t = DT_UNKNOWN)
+{
+  if (t == DT_UNKNOWN)
+  {
+    struct stat s;
+    if (fstatat (dfd, p, &s, AT_SYMLINK_NOFOLLOW) != 0)
+      return;
+
+    t = S_ISREG (s.st_mode) ? DT_REG : S_ISDIR (s.st_mode) ? DT_DIR : 0;
+  }
+
+  if (t != DT_REG && t != DT_DIR)
+    return;
+
+  int fd (openat (dfd,
+                  p,
+                  O_RDONLY | O_NONBLOCK | O_NOCTTY | O_NOFOLLOW | O_CLOEXEC));
+
+  if (fd != -1)
+  {
+    fadvise_dontneed (fd);
+    close (fd);
+  }
+}
+#endif
+
+#ifdef STAT_BENCHMARK_IO_URING
+// Minimal io_uring wrapper.
+//
+class uring
+{
+public:
+  // Throw failed if io_uring is not available or doesn't support
+  // IORING_OP_STATX.
+  //
+  explicit
+  uring (unsigned entries);
+
+  uring (const uring&) = delete;
+  uring& operator= (const uring&) = delete;
+
+  ~uring () {reset ();}
+
+  // Return the next submission queue entry (zero-initialized) or NULL if the
+  // queue is full.
+  //
+  io_uring_sqe*
+  get_sqe ();
+
+  // Submit the entries acquired with get_sqe() and wait for at least the
+  // specified number of completions.
+  //
+  void
+  submit (unsigned wait);
+
+  // Return the next available completion queue entry or NULL if there is
+  // none. Call cqe_seen() once done with the entry.
+  //
+  io_uring_cqe*
+  peek_cqe ()
+  {
+    unsigned h (*cq_head_);
+    return h != atomic_ref<unsigned> (*cq_tail_).load (memory_order_acquire)
+           ? &cqes_[h & cq_mask_]
+           : nullptr;
+  }
+
+  void
+  cqe_seen ()
+  {
+    atomic_ref<unsigned> (*cq_head_).store (*cq_head_ + 1,
+                                             memory_order_release);
+  }
+
+  // Number of io_uring_enter() calls made.
+  //
+  size_t
+  enter_calls () const {return enter_calls_;}
+
+private:
+  void
+  reset () noexcept;
+
+private:
+  int fd_ = -1;
+
+  void* sq_ptr_ = MAP_FAILED;
+  size_t sq_size_ = 0;
+  void* cq_ptr_ = MAP_FAILED;
+  size_t cq_size_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*> (MAP_FAILED);
+  size_t sqes_size_ = 0;
+
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned* sq_array_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  io_uring_cqe* cqes_;
+  unsigned cq_mask_;
+
+  unsigned sqe_tail_ = 0;  // Tail including the acquired entries.
+  unsigned to_submit_ = 0; // Entries acquired but not yet submitted.
+
+  size_t enter_calls_ = 0;
+};
+
+uring::
+uring (unsigned entries)
+{
+  io_uring_params p;
+  memset (&p, 0, sizeof (p));
+
+  fd_ = static_cast<int> (syscall (SYS_io_uring_setup, entries, &p));
+
+  if (fd_ == -1)
+  {
+    cerr << "error: io_uring is unavailable: io_uring_setup() failed: "
+         << last_errno_msg () << endl;
+    throw failed ();
+  }
+
+  // Make sure IORING_OP_STATX is supported (Linux 5.6 and later).
+  //
+  {
+    size_t n (sizeof (io_uring_probe) + 256 * sizeof (io_uring_probe_op));
+    unique_ptr<char[]> b (new char[n]);
+    memset (b.get (), 0, n);
+
+    io_uring_probe* pr (reinterpret_cast<io_uring_probe*> (b.get ()));
+
+    if (syscall (SYS_io_uring_register,
+                 fd_,
+                 IORING_REGISTER_PROBE,
+                 pr,
+                 256) != 0 ||
+        pr->last_op < IORING_OP_STATX ||
+        (pr->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED) == 0)
+    {
+      reset ();
+
+      cerr << "error: io_uring is unavailable: IORING_OP_STATX is not "
+           << "supported" << endl;
+      throw failed ();
+    }
+  }
+
+  auto fail = [this] (const char* what)
+  {
+    cerr << "error: unable to map io_uring " << what << ": "
+         << last_errno_msg () << endl;
+
+    reset ();
+    throw failed ();
+  };
+
+  sq_size_ = p.sq_off.array + p.sq_entries * sizeof (unsigned);
+  cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof (io_uring_cqe);
+
+  bool single (p.features & IORING_FEAT_SINGLE_MMAP);
+
+  if (single)
+    sq_size_ = cq_size_ = max (sq_size_, cq_size_);
+
+  sq_ptr_ = mmap (nullptr,
+                  sq_size_,
+                  PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE,
+                  fd_,
+                  IORING_OFF_SQ_RING);
+
+  if (sq_ptr_ == MAP_FAILED)
+    fail ("submission queue");
+
+  if (single)
+    cq_ptr_ = sq_ptr_;
+  else
+  {
+    cq_ptr_ = mmap (nullptr,
+                    cq_size_,
+                    PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE,
+                    fd_,
+                    IORING_OFF_CQ_RING);
+
+    if (cq_ptr_ == MAP_FAILED)
+      fail ("completion queue");
+  }
+
+  sqes_size_ = p.sq_entries * sizeof (io_uring_sqe);
+  sqes_ = static_cast<io_uring_sqe*> (mmap (nullptr,
+                                            sqes_size_,
+                                            PROT_READ | PROT_WRITE,
+                                            MAP_SHARED | MAP_POPULATE,
+                                            fd_,
+                                            IORING_OFF_SQES));
+
+  if (sqes_ == MAP_FAILED)
+    fail ("submission queue entries");
+
+  char* sq (static_cast<char*> (sq_ptr_));
+  char* cq (static_cast<char*> (cq_ptr_));
+
+  sq_head_ = reinterpret_cast<unsigned*> (sq + p.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*> (sq + p.sq_off.tail);
+  sq_array_ = reinterpret_cast<unsigned*> (sq + p.sq_off.array);
+  sq_mask_ = *reinterpret_cast<unsigned*> (sq + p.sq_off.ring_mask);
+  sq_entries_ = p.sq_entries;
+
+  cq_head_ = reinterpret_cast<unsigned*> (cq + p.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*> (cq + p.cq_off.tail);
+  cqes_ = reinterpret_cast<io_uring_cqe*> (cq + p.cq_off.cqes);
+  cq_mask_ = *reinterpret_cast<unsigned*> (cq + p.cq_off.ring_mask);
+
+  // Map the submission queue slots to the entries one-to-one.
+  //
+  for (unsigned i (0); i != sq_entries_; ++i)
+    sq_array_[i] = i;
+
+  sqe_tail_ = *sq_tail_;
+}
+
+void uring::
+reset () noexcept
+{
+  if (sqes_ != MAP_FAILED)
+  {
+    munmap (sqes_, sqes_size_);
+    sqes_ = static_cast<io_uring_sqe*> (MAP_FAILED);
+  }
+
+  if (cq_ptr_ != MAP_FAILED)
+  {
+    if (cq_ptr_ != sq_ptr_)
+      munmap (cq_ptr_, cq_size_);
+
+    cq_ptr_ = MAP_FAILED;
+  }
+
+  if (sq_ptr_ != MAP_FAILED)
+  {
+    munmap (sq_ptr_, sq_size_);
+    sq_ptr_ = MAP_FAILED;
+  }
+
+  if (fd_ != -1)
+  {
+    close (fd_);
+    fd_ = -1;
+  }
+}
+
+io_uring_sqe* uring::
+get_sqe ()
+{
+  unsigned h (atomic_ref<unsigned> (*sq_head_).load (memory_order_acquire));
+
+  if (sqe_tail_ - h == sq_entries_)
+    return nullptr;
+
+  io_uring_sqe* r (&sqes_[sqe_tail_ & sq_mask_]);
+  memset (r, 0, sizeof (*r));
+
+  ++sqe_tail_;
+  ++to_submit_;
+
+  return r;
+}
+
+void uring::
+submit (unsigned wait)
+{
+  // Publish the acquired entries.
+  //
+  atomic_ref<unsigned> (*sq_tail_).store (sqe_tail_, memory_order_release);
+
+  while (to_submit_ != 0 || wait != 0)
+  {
+    ++enter_calls_;
+
+    long r (syscall (SYS_io_uring_enter,
+                     fd_,
+                     to_submit_,
+                     wait,
+                     wait != 0 ? IORING_ENTER_GETEVENTS : 0,
+                     nullptr,
+                     0));
+
+    if (r == -1)
+    {
+      if (errno == EINTR)
+        continue;
+
+      cerr << "error: io_uring_enter() failed: " << last_errno_msg ()
+           << endl;
+      throw failed ();
+    }
+
+    to_submit_ -= static_cast<unsigned> (r);
+    wait = 0;
+  }
+}
+#endif
+
+// Measurement clock.
+//
+// By default, steady_clock is used. Optionally, the time stamp counter is
+// read directly with rdtscp and the ticks are converted to nanoseconds using
+// its frequency calibrated against steady_clock at startup (x86 only).
+//
+class bench_clock
+{
+public:
+  using ticks = uint64_t;
+
+  static ticks
+  now () noexcept
+  {
+#ifdef STAT_BENCHMARK_TSC
+    if (tsc_)
+    {
+      unsigned int a;
+      return __rdtscp (&a);
+    }
+#endif
+
+    return static_cast<ticks> (
+      duration_cast<nanoseconds> (
+        steady_clock::now ().time_since_epoch ()).count ());
+  }
+
+  static nanoseconds
+  elapsed (ticks start, ticks end) noexcept
+  {
+    return tsc_
+           ? nanoseconds (llround ((end - start) * ns_per_tick_))
+           : nanoseconds (end - start);
+  }
+
+  // Select the clock, calibrating the time stamp counter if requested, and
+  // print its resolution and reading overhead to stderr. Throw failed if the
+  // time stamp counter is unusable.
+  //
+  static void
+  init (bool tsc);
+
+private:
+  static inline bool tsc_ = false;
+  static inline double ns_per_tick_ = 1.0;
+};
+
+void bench_clock::
+init (bool tsc)
+{
+  if (tsc)
+  {
+#ifdef STAT_BENCHMARK_TSC
+    // Make sure the counter is invariant, that is, runs at the constant rate
+    // regardless of the CPU frequency scaling and sleep states.
+    //
+    unsigned int a, b, c, d;
+    if (__get_cpuid (0x80000007, &a, &b, &c, &d) == 0 ||
+        (d & (1U << 8)) == 0)
+    {
+      cerr << "error: time stamp counter is not invariant" << endl;
+      throw failed ();
+    }
+
+    // Calibrate the counter frequency against steady_clock.
+    //
+    unsigned int x;
+    steady_clock::time_point s (steady_clock::now ());
+    ticks t (__rdtscp (&x));
+
+    steady_clock::time_point se;
+    while ((se = steady_clock::now ()) - s < std::chrono::milliseconds (100))
+      ;
+
+    ticks te (__rdtscp (&x));
+
+    ns_per_tick_ =
+      static_cast<double> (duration_cast<nanoseconds> (se - s).count ()) /
+      (te - t);
+
+    tsc_ = true;
+#else
+    assert (false);
+#endif
+  }
+
+  // Resolution is the smallest non-zero difference between two consecutive
+  // readings.
+  //
+  ticks r (~ticks (0));
+  for (size_t i (0); i != 1000; ++i)
+  {
+    ticks s (now ()), e;
+    while ((e = now ()) == s)
+      ;
+
+    r = min (r, e - s);
+  }
+
+  // Overhead is the average time of a reading.
+  //
+  const size_t n (100000);
+  volatile ticks sink;
+
+  ticks s (now ());
+  for (size_t i (0); i != n; ++i)
+    sink = now ();
+  ticks e (now ());
+
+  (void) sink;
+
+  ostream::fmtflags fl (cerr.flags ());
+  streamsize pr (cerr.precision ());
+
+  cerr << "clock: " << (tsc_ ? "tsc" : "steady") << endl
+       << fixed << setprecision (1);
+
+  if (tsc_)
+    cerr << "clock frequency: " << 1 / ns_per_tick_ << " GHz" << endl;
+
+  cerr << "clock resolution: " << r * ns_per_tick_ << " nanoseconds" << endl
+       << "clock overhead: " << (e - s) * ns_per_tick_ / n << " nanoseconds"
+       << endl;
+
+  cerr.flags (fl);
+  cerr.precision (pr);
+}
+
+// Sample statistics.
+//
+struct sample_stats
+{
+  double min;
+  double max;
+  double median;
+  double mean;
+  double p90;
+  double p99;
+  double stddev;
+
+  explicit
+  sample_stats (vector<double>);
+};
+
+// Return the p-th (0 <= p <= 1) percentile of the sorted samples, linearly
+// interpolating between the closest ranks.
+//
+static double
+percentile (const vector<double>& ss, double p)
+{
+  assert (!ss.empty ());
+
+  double r (p * (ss.size () - 1));
+  size_t i (static_cast<size_t> (r));
+
+  return i + 1 < ss.size ()
+         ? ss[i] + (ss[i + 1] - ss[i]) * (r - i)
+         : ss[i];
+}
+
+sample_stats::
+sample_stats (vector<double> ss)
+{
+  assert (!ss.empty ());
+
+  sort (ss.begin (), ss.end ());
+
+  double sum (0);
+  for (double s: ss)
+    sum += s;
+
+  mean = sum / ss.size ();
+
+  double v (0);
+  for (double s: ss)
+    v += (s - mean) * (s - mean);
+
+  // Note: sample (rather than population) standard deviation.
+  //
+  stddev = ss.size () > 1 ? sqrt (v / (ss.size () - 1)) : 0;
+
+  min = ss.front ();
+  max = ss.back ();
+  median = percentile (ss, 0.5);
+  p90 = percentile (ss, 0.9);
+  p99 = percentile (ss, 0.99);
+}
+
+// Perform the warm-up runs followed by the measured runs and return the
+// times spent by the latter. Call start() once the warm-up runs are done
+// (for example, to reset the statistics collected by them).
+//
+template <typename S, typename R>
+static vector<nanoseconds>
+measure_runs (size_t warmup, size_t repeat, const S& start, const R& run)
+{
+  for (size_t i (0); i != warmup; ++i)
+    run ();
+
+  start ();
+
+  vector<nanoseconds> r;
+  r.reserve (repeat);
+
+  for (size_t i (0); i != repeat; ++i)
+    r.push_back (run ());
+
+  return r;
+}
+
+// Print the statistics for the measured runs over the specified number of
+// entries to stderr and return the representative (median, if repeated)
+// time.
+//
+static nanoseconds
+report_runs (size_t n, const vector<nanoseconds>& ds, size_t warmup)
+{
+  if (ds.size () == 1)
+  {
+    nanoseconds d (ds[0]);
+
+    cerr << "entries: " << n << endl
+         << "full time: " << d << endl
+         << "time per entry: " << d / n << endl;
+
+    return d;
+  }
+
+  vector<double> fs;
+  vector<double> es;
+
+  for (const nanoseconds& d: ds)
+  {
+    fs.push_back (static_cast<double> (d.count ()));
+    es.push_back (static_cast<double> (d.count ()) / n);
+  }
+
+  nanoseconds d (llround (sample_stats (move (fs)).median));
+  sample_stats s (move (es));
+
+  ostream::fmtflags fl (cerr.flags ());
+  streamsize pr (cerr.precision ());
+
+  cerr << "entries: " << n << endl
+       << "repetitions: " << ds.size () << endl
+       << "warm-up repetitions: " << warmup << endl
+       << "full time: " << d << endl
+       << "time per entry: " << d / n << endl
+       << fixed << setprecision (1)
+       << "time per entry min: " << s.min << " nanoseconds" << endl
+       << "time per entry median: " << s.median << " nanoseconds" << endl
+       << "time per entry mean: " << s.mean << " nanoseconds" << endl
+       << "time per entry p90: " << s.p90 << " nanoseconds" << endl
+       << "time per entry p99: " << s.p99 << " nanoseconds" << endl
+       << "time per entry stddev: " << s.stddev << " nanoseconds" << endl;
+
+  cerr.flags (fl);
+  cerr.precision (pr);
+
+  return d;
+}
+
+// Single-pass summary of a non-negative sample stream (see stats for
+// details).
+//
+// The count, minimum, maximum, mean, and standard deviation are exact (the
+// mean and variance are accumulated with Welford's algorithm). The robust
+// statistics are calculated from the sample counts keyed by their IEEE 754
+// representation, so they are exact and the memory is proportional to the
+// number of distinct samples rather than samples (which is small for the
+// typical integer nanosecond times).
+//
+// If the number of distinct samples exceeds the bound, then the keys are
+// truncated by a few mantissa bits at a time, merging the samples into
+// log-linear buckets, until the number of buckets is at most half the
+// bound. Each bucket is represented by its sample if all its samples are
+// equal and by their mean otherwise. After that the samples are accounted
+// for with the relative error below 2^-precision() (see exact()).
+//
+class sample_summary
+{
+public:
+  void
+  add (double);
+
+  uint64_t
+  count () const {return count_;}
+
+  double
+  min () const {return min_;}
+
+  double
+  max () const {return max_;}
+
+  double
+  mean () const {return mean_;}
+
+  // Sample (rather than population) standard deviation.
+  //
+  double
+  stddev () const {return count_ > 1 ? sqrt (m2_ / (count_ - 1)) : 0;}
+
+  // Return the p-th (0 <= p <= 1) percentile, linearly interpolating
+  // between the closest ranks (as percentile() does).
+  //
+  double
+  percentile (double p) const;
+
+  double
+  median () const {return percentile (0.5);}
+
+  // Return the median absolute deviation from the median.
+  //
+  double
+  mad () const;
+
+  // Return the mean of the samples remaining after discarding the
+  // specified fraction (0 <= t < 0.5) of the smallest and largest ones.
+  //
+  double
+  trimmed_mean (double t) const;
+
+  // Return the numbers of the samples below and above the median whose
+  // modified z-score (|x - median| / (1.4826 * MAD)) exceeds the threshold.
+  //
+  pair<uint64_t, uint64_t>
+  outliers (double threshold) const;
+
+  // Return true if the samples are accounted for exactly, that is, the
+  // number of distinct samples has never exceeded the bound.
+  //
+  bool
+  exact () const {return shift_ == 0;}
+
+  // Return the number of the mantissa bits the samples are accounted for
+  // with.
+  //
+  unsigned
+  precision () const {return shift_ < 52 ? 52 - shift_ : 0;}
+
+  // The maximum number of distinct samples (buckets) kept.
+  //
+  static constexpr size_t max_buckets = 1 << 18;
+
+private:
+  // Truncate the keys until the number of buckets is at most half the
+  // bound.
+  //
+  void
+  coarsen ();
+
+  struct bucket
+  {
+    uint64_t count;
+    double sum;
+    double first;
+    bool uniform; // All samples are equal to first.
+
+    double
+    value () const {return uniform ? first : sum / count;}
+  };
+
+  // Return the value of the sample with the specified (0-based) rank.
+  //
+  double
+  rank (uint64_t) const;
+
+  map<uint64_t, bucket> buckets_; // Keyed by the representation >> shift_.
+  unsigned shift_ = 0;
+  uint64_t count_ = 0;
+  double min_ = 0;
+  double max_ = 0;
+  double mean_ = 0;
+  double m2_ = 0;
+};
+
+void sample_summary::
+add (double v)
+{
+  assert (v >= 0 && isfinite (v));
+
+  // Note that the representation of the non-negative doubles is ordered.
+  //
+  uint64_t b;
+  memcpy (&b, &v, sizeof (b));
+
+  auto i (buckets_.emplace (b >> shift_, bucket {0, 0, v, true}).first);
+  bucket& k (i->second);
+
+  ++k.count;
+  k.sum += v;
+
+  if (v != k.first)
+    k.uniform = false;
+
+  if (buckets_.size () > max_buckets)
+    coarsen ();
+
+  if (count_ == 0 || v < min_) min_ = v;
+  if (count_ == 0 || v > max_) max_ = v;
+
+  ++count_;
+
+  double d (v - mean_);
+  mean_ += d / count_;
+  m2_ += d * (v - mean_);
+}
+
+void sample_summary::
+coarsen ()
+{
+  // Note that the representation has 64 bits so truncating by 64 bits or
+  // more would merge everything into a single bucket.
+  //
+  while (buckets_.size () > max_buckets / 2 && shift_ < 60)
+  {
+    const unsigned n (4);
+    shift_ += n;
+
+    map<uint64_t, bucket> bs;
+
+    for (const auto& p: buckets_)
+    {
+      auto r (bs.emplace (p.first >> n, p.second));
+
+      if (!r.second)
+      {
+        bucket& k (r.first->second);
+        const bucket& o (p.second);
+
+        k.count += o.count;
+        k.sum += o.sum;
+
+        if (!o.uniform || o.first != k.first)
+          k.uniform = false;
+      }
+    }
+
+    buckets_.swap (bs);
+  }
+}
+
+double sample_summary::
+rank (uint64_t r) const
+{
+  uint64_t c (0);
+  for (const auto& p: buckets_)
+  {
+    if ((c += p.second.count) > r)
+      return p.second.value ();
+  }
+
+  return max_;
+}
+
+double sample_summary::
+percentile (double p) const
+{
+  assert (count_ != 0);
+
+  double r (p * (count_ - 1));
+  uint64_t i (static_cast<uint64_t> (r));
+
+  double v (rank (i));
+  return i + 1 < count_ ? v + (rank (i + 1) - v) * (r - i) : v;
+}
+
+double sample_summary::
+mad () const
+{
+  double m (median ());
+
+  // Deviations of the bucket values and their counts.
+  //
+  vector<pair<double, uint64_t>> ds;
+  ds.reserve (buckets_.size ());
+
+  for (const auto& p: buckets_)
+    ds.emplace_back (abs (p.second.value () - m), p.second.count);
+
+  sort (ds.begin (), ds.end ());
+
+  auto rank = [&ds] (uint64_t r)
+  {
+    uint64_t c (0);
+    for (const auto& d: ds)
+    {
+      if ((c += d.second) > r)
+        return d.first;
+    }
+
+    return ds.back ().first;
+  };
+
+  double r (0.5 * (count_ - 1));
+  uint64_t i (static_cast<uint64_t> (r));
+
+  double v (rank (i));
+  return i + 1 < count_ ? v + (rank (i + 1) - v) * (r - i) : v;
+}
+
+double sample_summary::
+trimmed_mean (double t) const
+{
+  assert (count_ != 0 && t >= 0 && t < 0.5);
+
+  uint64_t k (static_cast<uint64_t> (t * count_)); // Trimmed from each end.
+  uint64_t n (count_ - 2 * k);
+
+  if (n == 0)
+    return median ();
+
+  double s (0);
+  uint64_t skip (k), take (n);
+
+  for (const auto& p: buckets_)
+  {
+    uint64_t c (p.second.count);
+
+    uint64_t sc (std::min (c, skip));
+    skip -= sc;
+    c -= sc;
+
+    uint64_t tc (std::min (c, take));
+    take -= tc;
+
+    if (tc != 0)
+      s += p.second.value () * tc;
+
+    if (take == 0)
+      break;
+  }
+
+  return s / n;
+}
+
+pair<uint64_t, uint64_t> sample_summary::
+outliers (double threshold) const
+{
+  double m (median ());
+  double d (threshold * 1.4826 * mad ());
+
+  pair<uint64_t, uint64_t> r (0, 0);
+
+  for (const auto& p: buckets_)
+  {
+    double v (p.second.value ());
+
+    if (v < m - d)
+      r.first += p.second.count;
+    else if (v > m + d)
+      r.second += p.second.count;
+  }
+
+  return r;
+}
+
+// Return the shortest representation of the value that converts back to
+// the same value.
+//
+static string
+exact_string (double v)
+{
+  char b[32];
+  to_chars_result r (to_chars (b, b + sizeof (b), v));
+  return string (b, r.ptr);
+}
+
+// Log-linear latency histogram with constant memory (similar to HDR
+// histogram). Values (in nanoseconds) below 2^P are recorded exactly while
+// larger ones are recorded into 2^P linear sub-buckets per power of two,
+// which gives the relative error below 2^-P (about 3%).
+//
+class histogram
+{
+public:
+  void
+  record (uint64_t v) noexcept
+  {
+    ++counts_[index (v)];
+    ++total_;
+
+    if (v < min_) min_ = v;
+    if (v > max_) max_ = v;
+  }
+
+  void
+  merge (const histogram&) noexcept;
+
+  void
+  clear () noexcept {*this = histogram ();}
+
+  uint64_t
+  total () const {return total_;}
+
+  uint64_t
+  min () const {return total_ != 0 ? min_ : 0;}
+
+  uint64_t
+  max () const {return max_;}
+
+  // Return the value at the specified (0 <= p <= 1) percentile, that is,
+  // the upper bound of the bucket containing it.
+  //
+  uint64_t
+  percentile (double p) const;
+
+  // Print the non-empty buckets, one per line, in the
+  // <prefix> <lower> <upper> <count> form.
+  //
+  void
+  dump (ostream&, const char* prefix) const;
+
+private:
+  static constexpr unsigned P = 5;
+  static constexpr uint64_t sub = uint64_t (1) << P;
+  static constexpr size_t buckets = (64 - P + 1) * sub;
+
+  static size_t
+  index (uint64_t v) noexcept
+  {
+    if (v < sub)
+      return static_cast<size_t> (v);
+
+    unsigned s (static_cast<unsigned> (bit_width (v)) - 1 - P);
+    return (s + 1) * sub + static_cast<size_t> ((v >> s) - sub);
+  }
+
+  static uint64_t
+  lower (size_t i) noexcept
+  {
+    if (i < sub)
+      return i;
+
+    size_t s (i / sub - 1);
+    return (sub + i % sub) << s;
+  }
+
+  static uint64_t
+  upper (size_t i) noexcept
+  {
+    return i < sub ? i : lower (i) + (uint64_t (1) << (i / sub - 1)) - 1;
+  }
+
+  array<uint64_t, buckets> counts_ {};
+  uint64_t total_ = 0;
+  uint64_t min_ = ~uint64_t (0);
+  uint64_t max_ = 0;
+};
+
+void histogram::
+merge (const histogram& h) noexcept
+{
+  for (size_t i (0); i != buckets; ++i)
+    counts_[i] += h.counts_[i];
+
+  total_ += h.total_;
+
+  if (h.min_ < min_) min_ = h.min_;
+  if (h.max_ > max_) max_ = h.max_;
+}
+
+uint64_t histogram::
+percentile (double p) const
+{
+  if (total_ == 0)
+    return 0;
+
+  uint64_t n (static_cast<uint64_t> (ceil (p * total_)));
+  if (n == 0)
+    n = 1;
+
+  uint64_t c (0);
+  for (size_t i (0); i != buckets; ++i)
+  {
+    if ((c += counts_[i]) >= n)
+      return std::min (upper (i), max_);
+  }
+
+  return max_;
+}
+
+void histogram::
+dump (ostream& os, const char* prefix) const
+{
+  for (size_t i (0); i != buckets; ++i)
+  {
+    if (counts_[i] != 0)
+      os << prefix << ' ' << lower (i) << ' ' << upper (i) << ' '
+         << counts_[i] << '\n';
+  }
+}
+
+// Per-operation latency histograms (see --histogram for details).
+//
+// The latencies are recorded into the thread-local histograms which are
+// then flushed into the collected ones.
+//
+struct latency_histograms
+{
+  histogram stat; // Entry stat calls.
+  histogram read; // Directory reading calls.
+
+  void
+  merge (const latency_histograms& h)
+  {
+    stat.merge (h.stat);
+    read.merge (h.read);
+  }
+
+  void
+  clear ()
+  {
+    stat.clear ();
+    read.clear ();
+  }
+};
+
+static bool latency_enabled (false);
+static thread_local latency_histograms latency_local;
+static latency_histograms latency_collected;
+static std::mutex latency_mutex;
+
+// Merge this thread's histograms into the collected ones and clear them.
+//
+static void
+latency_flush ()
+{
+  if (latency_enabled)
+  {
+    lock_guard<std::mutex> l (latency_mutex);
+    latency_collected.merge (latency_local);
+    latency_local.clear ();
+  }
+}
+
+// Call the function and, if enabled, record its latency into the histogram.
+//
+template <typename F>
+static inline auto
+latency_timed (histogram& h, const F& f) -> decltype (f ())
+{
+  if (!latency_enabled)
+    return f ();
+
+  bench_clock::ticks s (bench_clock::now ());
+  auto r (f ());
+  h.record (bench_clock::elapsed (s, bench_clock::now ()).count ());
+  return r;
+}
+
+#ifndef _WIN32
+// Read the entries of the directory stream, skipping . and .., and call
+// f(const dirent&) for each. If the histogram is not NULL, then record the
+// readdir() call latencies into it. Return false if readdir() fails (errno
+// is set) and true at the end of the stream.
+//
+template <typename F>
+static bool
+read_dir (DIR* h, histogram* lh, const F& f)
+{
+  for (;;)
+  {
+    errno = 0;
+    struct dirent* de (lh != nullptr
+                       ? latency_timed (*lh, [h] {return readdir (h);})
+                       : readdir (h));
+
+    if (de == nullptr)
+      return errno == 0; // End of stream or error.
+
+    const char* n (de->d_name);
+    if (n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0')))
+      continue;
+
+    f (*de);
+  }
+}
+
+// As above but open the directory d and close it before returning, timing
+// the readdir() calls into the read latency histogram (--histogram). Issue
+// diagnostics and throw failed on errors. Note that f may modify d provided
+// it restores it before returning.
+//
+template <typename F>
+static void
+read_dir (const string& d, const F& f)
+{
+  struct dir_deleter
+  {
+    void operator() (DIR* p) const
+    {
+      if (p != nullptr)
+        closedir (p);
+    }
+  };
+
+  unique_ptr<DIR, dir_deleter> h (opendir (d.c_str ()));
+
+  if (h == nullptr)
+  {
+    cerr << "error: opendir() failed for " << d << ": "
+         << last_errno_msg () << endl;
+    throw failed ();
+  }
+
+  if (!read_dir (h.get (), &latency_local.read, f))
+  {
+    cerr << "error: readdir() failed for " << d << ": "
+         << last_errno_msg () << endl;
+    throw failed ();
+  }
+}
+
+// Evict the directory n, relative to the parent directory file descriptor
+// pfd, and, recursively, all its entries from the page cache (see
+// evict_entry() for details). Only descend into the entries with the DT_DIR
+// type, similar to iter.
+//
+static void
+evict_tree (int pfd, const char* n)
+{
+  int fd (openat (pfd, n, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+
+  if (fd == -1)
+    return;
+
+  DIR* h (fdopendir (fd));
+
+  if (h == nullptr)
+  {
+    close (fd);
+    return;
+  }
+
+  // Note that the eviction is not timed.
+  //
+  read_dir (h,
+            nullptr,
+            [fd] (const dirent& de)
+            {
+              if (de.d_type == DT_DIR)
+                evict_tree (fd, de.d_name);
+              else
+                evict_entry (fd, de.d_name, de.d_type);
+            });
+
+  // Note: after reading, which brings the directory pages into the cache.
+  //
+  fadvise_dontneed (fd);
+  closedir (h);
+}
+#endif
+
+// Print the histogram percentile table to stderr.
+//
+static void
+print_latency (const char* what, const histogram& h)
+{
+  if (h.total () == 0)
+    return;
+
+  cerr << what << " latency (nanoseconds):" << endl
+       << "  count:  " << h.total () << endl
+       << "  min:    " << h.min () << endl
+       << "  p50:    " << h.percentile (0.5) << endl
+       << "  p90:    " << h.percentile (0.9) << endl
+       << "  p99:    " << h.percentile (0.99) << endl
+       << "  p99.9:  " << h.percentile (0.999) << endl
+       << "  p99.99: " << h.percentile (0.9999) << endl
+       << "  max:    " << h.max () << endl;
+}
+
+// Performance counter events (see --perf).
+//
+enum perf_event
+{
+  perf_cycles,
+  perf_instructions,
+  perf_cache_misses,
+  perf_context_switches,
+  perf_page_faults,
+  perf_event_count
+};
+
+static const char* const perf_event_names[perf_event_count] = {
+  "cycles", "instructions", "cache misses", "context switches", "page faults"};
+
+#ifdef STAT_BENCHMARK_PERF
+// Performance counters opened with perf_event_open() for the calling thread
+// and inherited by the threads it creates afterwards (whose counts are added
+// when they exit). The counts are accumulated over the start()/stop()
+// intervals.
+//
+// If not permitted (see perf_event_paranoid), the kernel space is not
+// counted and the context switches, which only happen there, are treated as
+// not supported. The events not supported (for example, the hardware events
+// in a virtual machine) are ignored.
+//
+class perf_counters
+{
+public:
+  // Throw failed if none of the events can be counted.
+  //
+  perf_counters ();
+
+  perf_counters (const perf_counters&) = delete;
+  perf_counters& operator= (const perf_counters&) = delete;
+
+  ~perf_counters ();
+
+  void
+  start ();
+
+  void
+  stop ();
+
+  bool
+  available (perf_event e) const {return fds_[e] != -1;}
+
+  // Return the accumulated count, scaled up if the counter was multiplexed.
+  //
+  double
+  value (perf_event e) const {return values_[e];}
+
+  // Return true if the kernel space is counted.
+  //
+  bool
+  kernel () const {return kernel_;}
+
+private:
+  int fds_[perf_event_count];
+  double values_[perf_event_count] = {};
+  bool kernel_ = true;
+};
+
+perf_counters::
+perf_counters ()
+{
+  static const pair<uint32_t, uint64_t> es[perf_event_count] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS}};
+
+  auto open = [this] (const pair<uint32_t, uint64_t>& e) -> int
+  {
+    perf_event_attr a;
+    memset (&a, 0, sizeof (a));
+
+    a.size = sizeof (a);
+    a.type = e.first;
+    a.config = e.second;
+    a.disabled = 1;
+    a.inherit = 1;
+    a.exclude_kernel = kernel_ ? 0 : 1;
+    a.exclude_hv = 1;
+    a.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                    PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    return static_cast<int> (syscall (SYS_perf_event_open,
+                                      &a,
+                                      0  /* pid (calling thread) */,
+                                      -1 /* cpu (any) */,
+                                      -1 /* group_fd (none) */,
+                                      PERF_FLAG_FD_CLOEXEC));
+  };
+
+  int e (0);
+  for (size_t i (0); i != perf_event_count; )
+  {
+    // Note that the context switch event would always count zero for the
+    // user space only.
+    //
+    if (!kernel_ && i == perf_context_switches)
+    {
+      fds_[i++] = -1;
+      continue;
+    }
+
+    int fd (open (es[i]));
+
+    if (fd == -1)
+    {
+      e = errno;
+
+      // If not permitted to count the kernel space, then start over
+      // counting the user space only.
+      //
+      if (kernel_ && (e == EACCES || e == EPERM))
+      {
+        for (size_t j (0); j != i; ++j)
+        {
+          if (fds_[j] != -1)
+            close (fds_[j]);
+        }
+
+        kernel_ = false;
+        i = 0;
+        continue;
+      }
+    }
+
+    fds_[i++] = fd;
+  }
+
+  if (find_if (begin (fds_), end (fds_), [] (int fd) {return fd != -1;}) ==
+      end (fds_))
+  {
+    cerr << "error: perf_event_open() failed: " << errno_msg (e) << endl;
+    throw failed ();
+  }
+}
+
+perf_counters::
+~perf_counters ()
+{
+  for (int fd: fds_)
+  {
+    if (fd != -1)
+      close (fd);
+  }
+}
+
+void perf_counters::
+start ()
+{
+  for (int fd: fds_)
+  {
+    if (fd != -1)
+    {
+      ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perf_counters::
+stop ()
+{
+  for (int fd: fds_)
+  {
+    if (fd != -1)
+      ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+  }
+
+  for (size_t i (0); i != perf_event_count; ++i)
+  {
+    if (fds_[i] == -1)
+      continue;
+
+    struct
+    {
+      uint64_t value;
+      uint64_t enabled;
+      uint64_t running;
+    } r;
+
+    if (read (fds_[i], &r, sizeof (r)) != sizeof (r))
+    {
+      cerr << "error: unable to read " << perf_event_names[i]
+           << " counter: " << last_errno_msg () << endl;
+      throw failed ();
+    }
+
+    if (r.running != 0)
+      values_[i] += r.running != r.enabled
+                    ? static_cast<double> (r.value) * r.enabled / r.running
+                    : static_cast<double> (r.value);
+  }
+}
+
+static optional<perf_counters> perf_collected;
+#endif
+
+// Structured result record (see --format for details).
+//
+// Note that the fields are printed in the order added and the values which
+// are not available are represented as null in JSON and empty in CSV.
+//
+class result_record
+{
+public:
+  void
+  add (const char* n, const string& v)
+  {
+    fields_.push_back (field {n, json_string (v), csv_string (v)});
+  }
+
+  void
+  add (const char* n, const char* v) {add (n, string (v));}
+
+  void
+  add (const char* n, uint64_t v)
+  {
+    string s (to_string (v));
+    fields_.push_back (field {n, s, s});
+  }
+
+  // Note that the non-finite values are represented as null.
+  //
+  void
+  add (const char* n, double v)
+  {
+    if (!isfinite (v))
+    {
+      add_null (n);
+      return;
+    }
+
+    string s (number (v));
+    fields_.push_back (field {n, s, s});
+  }
+
+  // In CSV the values are separated with semicolons.
+  //
+  void
+  add (const char* n, const vector<double>& vs)
+  {
+    string j ("[");
+    string c;
+
+    for (size_t i (0); i != vs.size (); ++i)
+    {
+      string s (number (vs[i]));
+
+      j += (i != 0 ? "," : "") + s;
+      c += (i != 0 ? ";" : "") + s;
+    }
+
+    j += ']';
+
+    fields_.push_back (field {n, move (j), move (c)});
+  }
+
+  void
+  add (const char* n, bool v)
+  {
+    const char* s (v ? "true" : "false");
+    fields_.push_back (field {n, s, s});
+  }
+
+  void
+  add_null (const char* n)
+  {
+    fields_.push_back (field {n, "null", ""});
+  }
+
+  // Print the record as a single-line JSON object.
+  //
+  void
+  print_json (ostream&) const;
+
+  // Print the CSV header line followed by the record line.
+  //
+  void
+  print_csv (ostream&) const;
+
+private:
+  // Note that the values are printed exactly (rather than rounded), so
+  // that the small per-entry rates are preserved and compare sees the same
+  // samples.
+  //
+  static string
+  number (double v) {return exact_string (v);}
+
+  static string
+  json_string (const string&);
+
+  static string
+  csv_string (const string&);
+
+  struct field
+  {
+    string name;
+    string json;
+    string csv;
+  };
+
+  vector<field> fields_;
+};
+
+string result_record::
+json_string (const string& v)
+{
+  string r ("\"");
+
+  for (char c: v)
+  {
+    switch (c)
+    {
+    case '"':  r += "\\\""; break;
+    case '\\': r += "\\\\"; break;
+    case '\n': r += "\\n"; break;
+    case '\t': r += "\\t"; break;
+    default:
+      {
+        if (static_cast<unsigned char> (c) < 0x20)
+        {
+          char b[7];
+          snprintf (b, sizeof (b), "\\u%04x", c);
+          r += b;
+        }
+        else
+          r += c;
+      }
+    }
+  }
+
+  r += '"';
+  return r;
+}
+
+string result_record::
+csv_string (const string& v)
+{
+  if (v.find_first_of (",\"\n") == string::npos)
+    return v;
+
+  string r ("\"");
+
+  for (char c: v)
+  {
+    if (c == '"')
+      r += '"';
+
+    r += c;
+  }
+
+  r += '"';
+  return r;
+}
+
+void result_record::
+print_json (ostream& os) const
+{
+  os << '{';
+
+  for (size_t i (0); i != fields_.size (); ++i)
+    os << (i != 0 ? "," : "") << json_string (fields_[i].name) << ':'
+       << fields_[i].json;
+
+  os << '}' << endl;
+}
+
+void result_record::
+print_csv (ostream& os) const
+{
+  for (size_t i (0); i != fields_.size (); ++i)
+    os << (i != 0 ? "," : "") << fields_[i].name;
+
+  os << endl;
+
+  for (size_t i (0); i != fields_.size (); ++i)
+    os << (i != 0 ? "," : "") << fields_[i].csv;
+
+  os << endl;
+}
+
+#ifndef _WIN32
+// Return the kernel name and release (for example, Linux 6.1.0).
+//
+static string
+kernel_version ()
+{
+  utsname u;
+  if (uname (&u) != 0)
+    return "unknown";
+
+  return string (u.sysname) + ' ' + u.release;
+}
+
+// Return the type of the filesystem the path resides on.
+//
+static string
+filesystem_type (const string& p)
+{
+  struct statfs s;
+  if (statfs (p.c_str (), &s) != 0)
+    return "unknown";
+
+#ifdef __linux__
+  struct type
+  {
+    unsigned long magic;
+    const char* name;
+  };
+
+  static const type types[] = {
+    {0xEF53,     "ext4"},
+    {0x58465342, "xfs"},
+    {0x9123683E, "btrfs"},
+    {0x01021994, "tmpfs"},
+    {0x794C7630, "overlayfs"},
+    {0x6969,     "nfs"},
+    {0xFE534D42, "smb2"},
+    {0xFF534D42, "cifs"},
+    {0x2FC12FC1, "zfs"},
+    {0x65735546, "fuse"},
+    {0xF2F52010, "f2fs"},
+    {0x4D44,     "vfat"},
+    {0x5346544E, "ntfs"},
+    {0x858458F6, "ramfs"},
+    {0x01021997, "9p"},
+    {0x6A656A63, "virtiofs"}};
+
+  for (const type& t: types)
+  {
+    if (static_cast<unsigned long> (s.f_type) == t.magic)
+      return t.name;
+  }
+
+  ostringstream os;
+  os << "0x" << hex << static_cast<unsigned long> (s.f_type);
+  return os.str ();
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || \
+      defined(__OpenBSD__)
+  return s.f_fstypename;
+#else
+  return "unknown";
+#endif
+}
+#endif
+
+#ifndef _WIN32
+// Heap allocation counting (see --count-allocs for details).
+//
+// Note that we replace the global allocation functions unconditionally and
+// only count the allocations while counting is enabled. The nothrow
+// versions are implemented in terms of these by the standard library but
+// the aligned ones (libstdc++ calls aligned_alloc() directly) have to be
+// replaced as well. Also note that the functions are not inlined to prevent
+// GCC from diagnosing the malloc()/free() calls as mismatched with
+// new/delete.
+//
+static atomic<bool> alloc_counting (false);
+static atomic<uint64_t> alloc_count (0);
+
+[[gnu::noinline]] void*
+operator new (size_t n)
+{
+  if (alloc_counting.load (memory_order_relaxed))
+    alloc_count.fetch_add (1, memory_order_relaxed);
+
+  if (void* p = malloc (n != 0 ? n : 1))
+    return p;
+
+  throw bad_alloc ();
+}
+
+[[gnu::noinline]] void*
+operator new[] (size_t n)
+{
+  return operator new (n);
+}
+
+[[gnu::noinline]] void
+operator delete (void* p) noexcept
+{
+  free (p);
+}
+
+[[gnu::noinline]] void
+operator delete[] (void* p) noexcept
+{
+  free (p);
+}
+
+[[gnu::noinline]] void
+operator delete (void* p, size_t) noexcept
+{
+  free (p);
+}
+
+[[gnu::noinline]] void
+operator delete[] (void* p, size_t) noexcept
+{
+  free (p);
+}
+
+[[gnu::noinline]] void*
+operator new (size_t n, align_val_t a)
+{
+  if (alloc_counting.load (memory_order_relaxed))
+    alloc_count.fetch_add (1, memory_order_relaxed);
+
+  // Note that posix_memalign() requires the alignment to be a multiple of
+  // the pointer size.
+  //
+  void* p;
+  if (posix_memalign (&p,
+                      max (static_cast<size_t> (a), sizeof (void*)),
+                      n != 0 ? n : 1) == 0)
+    return p;
+
+  throw bad_alloc ();
+}
+
+[[gnu::noinline]] void*
+operator new[] (size_t n, align_val_t a)
+{
+  return operator new (n, a);
+}
+
+[[gnu::noinline]] void
+operator delete (void* p, align_val_t) noexcept
+{
+  free (p);
+}
+
+[[gnu::noinline]] void
+operator delete[] (void* p, align_val_t) noexcept
+{
+  free (p);
+}
+
+[[gnu::noinline]] void
+operator delete (void* p, size_t, align_val_t) noexcept
+{
+  free (p);
+}
+
+[[gnu::noinline]] void
+operator delete[] (void* p, size_t, align_val_t) noexcept
+{
+  free (p);
+}
+#endif
+
+// Directory traversal statistics. Note that they are accumulated per thread
+// (see iter -j for details).
+//
+struct iter_counters
+{
+  size_t entries = 0; // Entries traversed.
+  size_t dirs = 0;    // Directories read (-g, -o only).
+  size_t reads = 0;   // Directory reading syscalls made (-g only).
+  size_t pruned = 0;  // Directories not read (--incremental only).
+};
+
+static thread_local iter_counters iter_stats;
+
+// Directory entries buffered for processing in the inode order (see iter
+// --order). The names are stored back to back, NUL-terminated, in a single
+// buffer so that there is no allocation per entry.
+//
+class dir_entries
+{
+public:
+  struct entry
+  {
+    uint64_t ino;
+    size_t name;       // Name offset in the names buffer.
+    unsigned char type;
+  };
+
+  void
+  add (uint64_t ino, unsigned char type, const char* n)
+  {
+    entries_.push_back (entry {ino, names_.size (), type});
+    names_.append (n, strlen (n) + 1);
+  }
+
+  void
+  sort_by_inode ()
+  {
+    sort (entries_.begin (), entries_.end (),
+          [] (const entry& x, const entry& y) {return x.ino < y.ino;});
+  }
+
+  const vector<entry>&
+  entries () const {return entries_;}
+
+  const char*
+  name (const entry& e) const {return names_.c_str () + e.name;}
+
+  void
+  clear () {entries_.clear (); names_.clear ();}
+
+private:
+  vector<entry> entries_;
+  string names_;
+};
+
+// Join the threads that are still joinable on destruction, first calling
+// the stop function to make them exit. This way no thread is destroyed
+// joinable (which terminates the process) if we leave the scope via an
+// exception, for example, because starting some of them failed.
+//
+template <typename S>
+class thread_guard
+{
+public:
+  thread_guard (vector<thread>& ts, S stop): ts_ (ts), stop_ (move (stop)) {}
+
+  thread_guard (const thread_guard&) = delete;
+  thread_guard& operator= (const thread_guard&) = delete;
+
+  ~thread_guard ()
+  {
+    if (any_of (ts_.begin (), ts_.end (),
+                [] (const thread& t) {return t.joinable ();}))
+    {
+      stop_ ();
+      join ();
+    }
+  }
+
+  void
+  join ()
+  {
+    for (thread& t: ts_)
+    {
+      if (t.joinable ())
+        t.join ();
+    }
+  }
+
+private:
+  vector<thread>& ts_;
+  S stop_;
+};
+
+// Work-stealing task pool. Each worker thread owns a deque of tasks. It pops
+// its own tasks from the back (depth-first, which is cache-friendly) and,
+// when its deque is empty, steals from the front of the other deques (which
+// tend to contain tasks closer to the root and thus larger sub-trees).
+//
+// The idle workers (that have nothing to pop or steal while some tasks are
+// still being processed) are parked on the condition variable until a task
+// is pushed rather than spinning, so that they don't contend for the deque
+// locks and don't burn the CPU time that is being measured.
+//
+template <typename T>
+class work_stealing_pool
+{
+public:
+  explicit
+  work_stealing_pool (size_t n): queues_ (n) {}
+
+  size_t
+  size () const {return queues_.size ();}
+
+  // Push the task to the deque of the specified worker. Can be called from
+  // the task function itself.
+  //
+  void
+  push (size_t w, T t)
+  {
+    pending_.fetch_add (1);
+
+    {
+      queue& q (queues_[w]);
+      lock_guard<mutex> l (q.mutex);
+      q.tasks.push_back (move (t));
+    }
+
+    available_.fetch_add (1);
+    wake (false);
+  }
+
+  // Run f (w, t) for every task, including the ones pushed while running,
+  // on the worker threads and return when all the tasks are processed.
+  // Before the worker thread exits, call d (w) on it.
+  //
+  // If any task throws, then stop processing and rethrow the exception.
+  //
+  template <typename F, typename D>
+  void
+  run (const F& f, const D& d)
+  {
+    vector<thread> ts;
+    ts.reserve (queues_.size ());
+
+    thread_guard g (ts, [this] {stop_ = true; wake (true);});
+
+    for (size_t w (0); w != queues_.size (); ++w)
+      ts.emplace_back ([this, &f, &d, w] {work (w, f); d (w);});
+
+    g.join ();
+
+    if (exception_)
+      rethrow_exception (exception_);
+  }
+
+private:
+  // Wake up one or all the parked workers, if any.
+  //
+  // Note that the parking worker increments the idle counter before
+  // checking the wake up condition (both under the idle mutex) and we
+  // change the condition before checking the counter, so either it sees the
+  // change or we see it parking and notify it after it started waiting
+  // (since we lock the mutex).
+  //
+  void
+  wake (bool all)
+  {
+    if (idle_ != 0)
+    {
+      lock_guard<mutex> l (idle_mutex_);
+
+      if (all)
+        idle_cv_.notify_all ();
+      else
+        idle_cv_.notify_one ();
+    }
+  }
+
+  optional<T>
+  pop (size_t w)
+  {
+    queue& q (queues_[w]);
+    lock_guard<mutex> l (q.mutex);
+
+    if (q.tasks.empty ())
+      return nullopt;
+
+    T r (move (q.tasks.back ()));
+    q.tasks.pop_back ();
+    available_.fetch_sub (1);
+    return r;
+  }
+
+  optional<T>
+  steal (size_t w)
+  {
+    for (size_t i (1); i != queues_.size (); ++i)
+    {
+      queue& q (queues_[(w + i) % queues_.size ()]);
+      lock_guard<mutex> l (q.mutex);
+
+      if (!q.tasks.empty ())
+      {
+        T r (move (q.tasks.front ()));
+        q.tasks.pop_front ();
+        available_.fetch_sub (1);
+        return r;
+      }
+    }
+
+    return nullopt;
+  }
+
+  template <typename F>
+  void
+  work (size_t w, const F& f)
+  {
+    while (!stop_)
+    {
+      optional<T> t (pop (w));
+
+      if (!t)
+        t = steal (w);
+
+      if (!t)
+      {
+        // Note that the pending tasks counter is only decremented after the
+        // task (and so all the tasks it pushes) is processed.
+        //
+        if (pending_ == 0)
+          break;
+
+        // Park until a task is pushed, all the tasks are processed, or we
+        // are stopped.
+        //
+        unique_lock<mutex> l (idle_mutex_);
+        ++idle_;
+        idle_cv_.wait (l,
+                       [this]
+                       {
+                         return available_ != 0 || pending_ == 0 || stop_;
+                       });
+        --idle_;
+        continue;
+      }
+
+      try
+      {
+        f (w, *t);
+      }
+      catch (...)
+      {
+        lock_guard<mutex> l (exception_mutex_);
+
+        if (!exception_)
+          exception_ = current_exception ();
+
+        stop_ = true;
+        wake (true);
+      }
+
+      // Wake up the parked workers for them to exit if this was the last
+      // task.
+      //
+      if (pending_.fetch_sub (1) == 1)
+        wake (true);
+    }
+  }
+
+  struct queue
+  {
+    std::mutex mutex;
+    deque<T> tasks;
+  };
+
+  vector<queue> queues_;
+  atomic<size_t> pending_ {0};   // Tasks pushed but not yet processed.
+  atomic<size_t> available_ {0}; // Tasks in the deques.
+  atomic<bool> stop_ {false};
+
+  std::mutex idle_mutex_;
+  condition_variable idle_cv_;
+  atomic<size_t> idle_ {0};      // Parked workers.
+
+  std::mutex exception_mutex_;
+  exception_ptr exception_;
+};
+
+// Bounded lock-free multi-producer multi-consumer queue (Dmitry Vyukov's
+// algorithm).
+//
+// Each cell carries a sequence number which tells whether it is ready to be
+// written (equals the enqueue position) or read (equals the dequeue position
+// plus one). The producers and consumers claim the positions with CAS and
+// then access the cells without any further synchronization. Note that the
+// values are accessed in place by the passed functions (rather than moved
+// in and out), so that, for example, the string buffers can be reused.
+//
+template <typename T>
+class mpmc_queue
+{
+public:
+  // Note that the capacity must be a power of two.
+  //
+  explicit
+  mpmc_queue (size_t capacity)
+      : cells_ (new cell[capacity]), mask_ (capacity - 1)
+  {
+    assert (capacity >= 2 && (capacity & mask_) == 0);
+
+    for (size_t i (0); i != capacity; ++i)
+      cells_[i].seq.store (i, memory_order_relaxed);
+  }
+
+  // Call f (T&) on the claimed cell and return true or return false if the
+  // queue is full.
+  //
+  template <typename F>
+  bool
+  try_push (const F& f)
+  {
+    size_t p (enqueue_pos_.load (memory_order_relaxed));
+
+    for (;;)
+    {
+      cell& c (cells_[p & mask_]);
+      size_t s (c.seq.load (memory_order_acquire));
+      intptr_t d (static_cast<intptr_t> (s) - static_cast<intptr_t> (p));
+
+      if (d == 0)
+      {
+        if (enqueue_pos_.compare_exchange_weak (p, p + 1,
+                                                memory_order_relaxed))
+        {
+          f (c.value);
+          c.seq.store (p + 1, memory_order_release);
+          return true;
+        }
+      }
+      else if (d < 0)
+        return false;
+      else
+        p = enqueue_pos_.load (memory_order_relaxed);
+    }
+  }
+
+  // Call f (T&) on the claimed cell and return true or return false if the
+  // queue is empty.
+  //
+  template <typename F>
+  bool
+  try_pop (const F& f)
+  {
+    size_t p (dequeue_pos_.load (memory_order_relaxed));
+
+    for (;;)
+    {
+      cell& c (cells_[p & mask_]);
+      size_t s (c.seq.load (memory_order_acquire));
+      intptr_t d (static_cast<intptr_t> (s) - static_cast<intptr_t> (p + 1));
+
+      if (d == 0)
+      {
+        if (dequeue_pos_.compare_exchange_weak (p, p + 1,
+                                                memory_order_relaxed))
+        {
+          f (c.value);
+          c.seq.store (p + mask_ + 1, memory_order_release);
+          return true;
+        }
+      }
+      else if (d < 0)
+        return false;
+      else
+        p = dequeue_pos_.load (memory_order_relaxed);
+    }
+  }
+
+private:
+  struct cell
+  {
+    atomic<size_t> seq;
+    T value;
+  };
+
+  unique_ptr<cell[]> cells_;
+  size_t mask_;
+
+  // Keep the positions on separate cache lines.
+  //
+  alignas (64) atomic<size_t> enqueue_pos_ {0};
+  alignas (64) atomic<size_t> dequeue_pos_ {0};
+};
+
+// Synthetic directory tree generation (see gen for details).
+//
+// Note that we use our own pseudo-random number generator (SplitMix64) and
+// distributions since the standard ones are implementation-defined and the
+// generated tree must be the same for the same seed everywhere.
+//
+class gen_random
+{
+public:
+  explicit
+  gen_random (uint64_t seed): state_ (seed) {}
+
+  uint64_t
+  next ()
+  {
+    uint64_t z (state_ += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+
+  // Return a value uniformly distributed in the [min, max] range.
+  //
+  uint64_t
+  range (uint64_t min, uint64_t max)
+  {
+    uint64_t n (max - min + 1);
+    return n != 0 ? min + next () % n : next ();
+  }
+
+  // Return true with the specified probability.
+  //
+  bool
+  chance (double p)
+  {
+    return static_cast<double> (next () >> 11) * 0x1.0p-53 < p;
+  }
+
+  // Derive the seed for the child (for example, sub-directory) from the
+  // parent seed and the child index.
+  //
+  static uint64_t
+  derive (uint64_t seed, uint64_t index)
+  {
+    return gen_random (seed ^ (index + 1) * 0xD1B54A32D192ED03ULL).next ();
+  }
+
+private:
+  uint64_t state_;
+};
+
+// Parse the <n> or <min>-<max> value range.
+//
+static bool
+parse_gen_range (const string& s, uint64_t& min, uint64_t& max)
+{
+  auto num = [] (const string& v, uint64_t& r) -> bool
+  {
+    if (v.empty () || v.find_first_not_of ("0123456789") != string::npos)
+      return false;
+
+    r = stoull (v);
+    return true;
+  };
+
+  size_t p (s.find ('-'));
+
+  if (p == string::npos)
+  {
+    if (!num (s, min))
+      return false;
+
+    max = min;
+    return true;
+  }
+
+  return num (s.substr (0, p), min) &&
+         num (s.substr (p + 1), max) &&
+         min <= max;
+}
+
+// Result records comparison (see compare for details).
+//
+// The per-entry time samples of a benchmarked method, one per repetition.
+//
+struct method_samples
+{
+  string benchmark;
+  string method;
+  vector<double> samples;
+};
+
+// Parse the single-line JSON result record (see --format), extracting the
+// benchmark, method, and per-entry time samples. Return false if the line is
+// not a valid record.
+//
+// Note that only the subset of JSON produced by result_record is supported:
+// a flat object with the string, number, boolean, null, and number array
+// values.
+//
+static bool
+parse_result_record (const string& l, method_samples& r)
+{
+  const char* p (l.c_str ());
+
+  auto ws = [&p] ()
+  {
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+      ++p;
+  };
+
+  auto str = [&p] (string& s) -> bool
+  {
+    if (*p++ != '"')
+      return false;
+
+    for (s.clear (); *p != '"'; ++p)
+    {
+      if (*p == '\0')
+        return false;
+
+      if (*p != '\\')
+      {
+        s += *p;
+        continue;
+      }
+
+      switch (*++p)
+      {
+      case '"':  s += '"';  break;
+      case '\\': s += '\\'; break;
+      case '/':  s += '/';  break;
+      case 'n':  s += '\n'; break;
+      case 't':  s += '\t'; break;
+      case 'u':
+        {
+          // We only produce the control characters this way.
+          //
+          unsigned int c;
+          if (sscanf (p + 1, "%4x", &c) != 1 || c > 0x7f)
+            return false;
+
+          s += static_cast<char> (c);
+          p += 4;
+          break;
+        }
+      default: return false;
+      }
+    }
+
+    ++p;
+    return true;
+  };
+
+  auto num = [&p] (double& v) -> bool
+  {
+    char* e;
+    v = strtod (p, &e);
+
+    if (e == p)
+      return false;
+
+    p = e;
+    return true;
+  };
+
+  bool bm (false), mt (false), ss (false);
+
+  ws ();
+  if (*p++ != '{')
+    return false;
+
+  for (ws (); *p != '}'; ws ())
+  {
+    string n;
+    if (!str (n))
+      return false;
+
+    ws ();
+    if (*p++ != ':')
+      return false;
+
+    ws ();
+
+    if (*p == '"')
+    {
+      string v;
+      if (!str (v))
+        return false;
+
+      if (n == "benchmark")
+      {
+        r.benchmark = move (v);
+        bm = true;
+      }
+      else if (n == "method")
+      {
+        r.method = move (v);
+        mt = true;
+      }
+    }
+    else if (*p == '[')
+    {
+      vector<double> vs;
+
+      for (++p, ws (); *p != ']'; ws ())
+      {
+        double v;
+        if (!num (v))
+          return false;
+
+        vs.push_back (v);
+
+        ws ();
+        if (*p == ',')
+          ++p;
+        else if (*p != ']')
+          return false;
+      }
+
+      ++p;
+
+      if (n == "per_entry_samples_ns")
+      {
+        r.samples = move (vs);
+        ss = true;
+      }
+    }
+    else if (strncmp (p, "null", 4) == 0 || strncmp (p, "true", 4) == 0)
+      p += 4;
+    else if (strncmp (p, "false", 5) == 0)
+      p += 5;
+    else
+    {
+      double v;
+      if (!num (v))
+        return false;
+    }
+
+    ws ();
+    if (*p == ',')
+      ++p;
+    else if (*p != '}')
+      return false;
+  }
+
+  ++p;
+  ws ();
+
+  return *p == '\0' && bm && mt && ss && !r.samples.empty ();
+}
+
+// Return the two-sided p-value of the Mann-Whitney U test for the samples,
+// together with the U statistic of the first sample. The p-value is
+// calculated using the normal approximation with the tie and continuity
+// corrections, which is reasonably accurate starting from about 8 samples
+// each.
+//
+static pair<double, double>
+mann_whitney (const vector<double>& x, const vector<double>& y)
+{
+  // Rank the pooled samples, assigning the tied values their average rank.
+  //
+  vector<pair<double, bool>> vs; // Value and whether from x.
+  vs.reserve (x.size () + y.size ());
+
+  for (double v: x) vs.emplace_back (v, true);
+  for (double v: y) vs.emplace_back (v, false);
+
+  sort (vs.begin (), vs.end ());
+
+  double n1 (static_cast<double> (x.size ()));
+  double n2 (static_cast<double> (y.size ()));
+  double n (n1 + n2);
+
+  double r1 (0); // Sum of the x ranks.
+  double ts (0); // Sum of t^3 - t over the tie groups.
+
+  for (size_t i (0); i != vs.size (); )
+  {
+    size_t j (i + 1);
+    while (j != vs.size () && vs[j].first == vs[i].first)
+      ++j;
+
+    double t (static_cast<double> (j - i));
+    double r ((i + 1 + j) / 2.0); // Average of the ranks i + 1 to j.
+
+    for (size_t k (i); k != j; ++k)
+    {
+      if (vs[k].second)
+        r1 += r;
+    }
+
+    ts += t * t * t - t;
+    i = j;
+  }
+
+  double u (r1 - n1 * (n1 + 1) / 2);
+  double mu (n1 * n2 / 2);
+  double sigma (sqrt (n1 * n2 / 12 * ((n + 1) - ts / (n * (n - 1)))));
+
+  if (sigma == 0 || isnan (sigma))
+    return make_pair (u, 1.0);
+
+  double z (max (abs (u - mu) - 0.5, 0.0) / sigma);
+  return make_pair (u, erfc (z / sqrt (2.0)));
+}
+
+// Return the bootstrap confidence interval (percentile method) for the
+// relative difference, in percent, between the medians of the candidate (y)
+// and baseline (x) samples. Note that the resampling is seeded so that the
+// result is reproducible. Also note that the resamples with the zero
+// baseline median (which can only happen if many baseline samples are zero)
+// are skipped and the baseline sample median itself must not be zero.
+//
+static pair<double, double>
+bootstrap_ci (const vector<double>& x,
+              const vector<double>& y,
+              double confidence,
+              size_t resamples)
+{
+  gen_random g (0);
+
+  vector<double> xs (x.size ());
+  vector<double> ys (y.size ());
+  vector<double> ds;
+  ds.reserve (resamples);
+
+  auto resample = [&g] (const vector<double>& s, vector<double>& r)
+  {
+    for (double& v: r)
+      v = s[g.range (0, s.size () - 1)];
+
+    sort (r.begin (), r.end ());
+    return percentile (r, 0.5);
+  };
+
+  for (size_t i (0); i != resamples; ++i)
+  {
+    double mx (resample (x, xs));
+    double my (resample (y, ys));
+
+    if (mx != 0)
+      ds.push_back ((my - mx) / mx * 100);
+  }
+
+  if (ds.empty ())
+    return make_pair (0.0, 0.0);
+
+  sort (ds.begin (), ds.end ());
+
+  double a ((1 - confidence) / 2);
+  return make_pair (percentile (ds, a), percentile (ds, 1 - a));
+}
+
+// Usages:
+//
+//  Windows:
+//    argv[0] stat (-a|-e|-h) [<repeat>] [-r] <file>
+//    argv[0] iter (-p|-n|-N) [-a|-e|-h] [-P <level>|<repeat>] [-r] <dir>
+//
+//    Where <repeat> is [--repeat <n>] [--warmup <n>].
+//
+//  POSIX:
+//    argv[0] stat (-s|-x [--mask <fields>]) [-j <threads> [--shard <strategy>]]
+//                 [<repeat>] [-r] <file>
+//    argv[0] stat -u [--mask <fields>] [--queue-depth <n>] [--batch <n>]
+//                 [<repeat>] [-r] <file>
+//    argv[0] iter (-o|-f|-g [--dirent-buf <bytes>]) [-s|-x [--mask <fields>]]
+//                 [--order <order>]
+//                 [-P <level> [--null]|-j <threads>|<repeat>] [-r] <dir>
+//    argv[0] iter (-o|-f|-g [--dirent-buf <bytes>]) (-s|-x [--mask <fields>])
+//                 [--order <order>] --snapshot <index>
+//                 [-P <level> [--null]|<repeat>] [-r] <dir>
+//    argv[0] iter -o (-s|-x [--mask <fields>]) --pipeline <workers>
+//                 [<repeat>] [-r] <dir>
+//    argv[0] iter -o (-s|-x [--mask <fields>]) --incremental <index>
+//                 [<repeat>] [-r] <dir>
+//    argv[0] diff (-o|-f|-g [--dirent-buf <bytes>]) (-s|-x [--mask <fields>])
+//                 [--order <order>] [-P <level> [--null]|<repeat>] [-r]
+//                 <index> <dir>
+//    argv[0] gen [--depth <n>] [--fanout <n>] [--files <n>]
+//                [--name-length <range>] [--size <range>]
+//                [--symlinks <ratio>] [--seed <n>] [-j <threads>] <dir>
+//
+//    Where <repeat> is [--repeat <n>] [--warmup <n>]. Additionally, the
+//    stat, iter, and diff forms accept [--clock <clock>], [--histogram]
+//    [--histogram-dump <file>], [--format <format>], [--count-allocs],
+//    [--cold], [--perf], [--cpu <list>], [--sched <policy>], and
+//    [--mlockall].
+//
+//    The stat, iter, and diff forms also print to stderr the user and
+//    system CPU time, voluntary and involuntary context switches, and major
+//    and minor page faults per entry, all taken with getrusage() for the
+//    whole process (worker threads included) over the measured runs.
+//
+//  Common:
+//    argv[0] stats [--trim <fraction>] [-r] <file>|-
+//    argv[0] compare [--threshold <percent>] [--alpha <level>]
+//                    <baseline> <candidate>
+//
+// In the first form reads the specified file containing filesystem entry
+// paths, one per line. Stat each path, retrieving the entry modification and
+// access times, using the specified stat method, and print the retrieval
+// statistics to stderr. On POSIX the file is memory-mapped rather than read
+// and the loading time and the peak resident set size after loading are
+// also printed.
+//
+// In the second form iterate through the sub-entries of the specified
+// directory, recursively. Optionally, stat each path. Print the traversal
+// statistics to stderr.
+//
+// The stats form reads the samples (for example, the per-entry times
+// printed with -r by multiple runs), separated with whitespaces, from the
+// file or stdin (-) and prints their count, minimum, maximum, mean,
+// standard deviation, median, median absolute deviation (MAD), trimmed
+// mean, and the number of outliers (the samples whose modified z-score,
+// |x - median| / (1.4826 * MAD), exceeds 3.5) to stderr. The samples must
+// be non-negative. The statistics are calculated in a single pass, storing
+// the counts of the distinct samples only, and are exact unless there are
+// more than 262144 distinct samples, in which case the median, MAD, trimmed
+// mean, and outliers are approximated and a note with the precision is
+// printed (see sample_summary for details). The values are printed in the
+// shortest form that preserves them exactly. With -r the median is also
+// printed to stdout.
+//
+// The compare form reads the baseline and candidate files, each containing
+// the JSON result records (see --format), one per line, and compares the
+// per-entry time samples of each benchmarked method found in both files.
+// The samples of the records for the same method (benchmark and method
+// fields) are pooled. For each method print to stdout the sample counts and
+// medians, the relative median difference, its bootstrap confidence
+// interval, and the Mann-Whitney U test p-value, followed by the verdict.
+// The change is considered a regression (improvement) if the candidate
+// median is greater (less) than the baseline one by more than the threshold,
+// the p-value is less than the significance level, and the confidence
+// interval lies entirely above (below) zero. The methods with the zero
+// baseline median (for example, due to a coarse clock) can not be compared
+// and are reported as such. Exit with the status 2 if any regression is
+// detected. Note that the test requires several repetitions per method (see
+// --repeat) to detect anything.
+//
+// The diff form traverses the specified directory, similar to iter, and
+// compares each entry against the snapshot index previously written with
+// iter --snapshot for the same directory, printing the numbers of the added,
+// removed, and modified (inode, size, or modification time differ) entries
+// to stderr. With -P the changed entries are also printed to stdout, one per
+// line, prefixed with A, D, or M, respectively. Additionally, stat all the
+// index entries by path (without traversing), measured the same way as the
+// diff (see --warmup, --repeat, and --cold), and print the time as well as
+// the ratio of the diff and re-stat times.
+//
+// The gen form creates the specified directory and generates a synthetic
+// tree in it. Every directory up to the specified depth contains the
+// specified number of sub-directories and files. The names consist of the
+// [a-z0-9_] characters, the files are filled with zeros, and the symlinks
+// refer to the regular files in the same directory. The tree is completely
+// determined by the parameters and the seed (but not the thread count).
+// Print the generated entry counts and the generation time to stderr.
+//
+// -a
+//    Use GetFileAttributesA() to stat the filesystem entries (note:
+//    modification and access times are not retrieved).
+//
+// -e
+//    Use GetFileAttributesExA() to stat the filesystem entries.
+//
+// -h
+//    Use CreateFile() and GetFileInformationByHandle() to stat the filesystem
+//    entries.
+//
+// -s
+//    Use stat() to stat the filesystem entries.
+//
+// -x
+//    Use statx() to stat the filesystem entries (Linux only).
+//
+// --mask <fields>
+//    Comma-separated list of the statx() fields to request. Valid names are
+//    type, mode, nlink, uid, gid, atime, mtime, ctime, ino, size, blocks,
+//    btime, and basic (STATX_BASIC_STATS). Additionally, the dont-sync
+//    (AT_STATX_DONT_SYNC) or force-sync (AT_STATX_FORCE_SYNC) flag can be
+//    specified. If unspecified, then mtime,atime is assumed. Note that the
+//    times which are not requested are reported as unknown.
+//
+// -u
+//    Use io_uring to submit the statx() requests (IORING_OP_STATX) for the
+//    entries in batches, reaping the completions asynchronously (Linux 5.6
+//    and later). Additionally, print the number of the io_uring_enter()
+//    syscalls made to stderr.
+//
+// --queue-depth <n>
+//    The maximum number of the io_uring statx() requests in flight. If
+//    unspecified, then 64 is assumed.
+//
+// --batch <n>
+//    The number of the io_uring statx() requests to queue before submitting
+//    them. Must not exceed the queue depth, which is also the default.
+//
+// -p
+//    Use _findfirst() and _findnext() to traverse the directory.
+//
+// -n
+//    Use FindFirstFileA() and FindNextFileA() to traverse the directory.
+//
+// -N
+//    Use FindFirstFileExA() and FindNextFileA() to traverse the directory.
+//
+// -o
+//    Use opendir() and readdir() to traverse the directory.
+//
+// -f
+//    Use openat(), fdopendir(), and readdir() to traverse the directory,
+//    opening the sub-directories and stating the entries (fstatat() or
+//    statx()) relative to the parent directory file descriptor rather than
+//    via the full path.
+//
+// -g
+//    Similar to -f but read the directory entries using the getdents64()
+//    syscall directly into the user buffer rather than readdir() (Linux
+//    only). Additionally, print the number of the syscalls made per
+//    directory to stderr.
+//
+// --dirent-buf <bytes>
+//    The getdents64() buffer size. If unspecified, then 32768 is assumed.
+//
+// --order <order>
+//    The directory traversal order. Valid values are dfs (depth-first, in
+//    the directory reading order, default), bfs (breadth-first, opening the
+//    sub-directories via their full paths), and inode (depth-first but with
+//    each directory's entries sorted by inode number before they are stated
+//    or descended into, which on filesystems like ext4 and xfs matches the
+//    on-disk inode table locality). Note that for inode the directory is
+//    read completely before its entries are processed. Can not be combined
+//    with -j, --pipeline, or --incremental.
+//
+// -r
+//    Print the average time in nanoseconds spent on the processing of a
+//    filesystem entry to stdout. If the measurement is repeated, then print
+//    the median of such times.
+//
+// --repeat <n>
+//    Repeat the measurement the specified number of times in the same
+//    process, keeping the loaded entry paths in memory. Additionally, print
+//    the minimum, median, mean, 90th and 99th percentiles, and the standard
+//    deviation of the time per entry to stderr. Note that the full time and
+//    the time per entry are then printed for the median run.
+//
+// --warmup <n>
+//    Perform the specified number of unmeasured runs before the measured
+//    ones.
+//
+// --clock <clock>
+//    The clock to use for measurements. Valid values are steady (the
+//    monotonic steady_clock, default) and tsc (the time stamp counter read
+//    with rdtscp and calibrated against steady_clock, x86 only). The clock
+//    resolution and reading overhead are printed to stderr at startup.
+//
+// --histogram
+//    Time each entry stat and directory read (readdir() or getdents64())
+//    call, record the latencies into log-linear histograms with constant
+//    memory, and print their percentiles to stderr. For io_uring the stat
+//    latency is from queuing the request to reaping its completion. Note
+//    that the recording adds two clock readings per call (see --clock for
+//    their overhead) and that only the measured runs are recorded.
+//
+// --histogram-dump <file>
+//    As --histogram but also write the non-empty histogram buckets into the
+//    file, one per line, in the <histogram> <lower> <upper> <count> form.
+//
+// --format <format>
+//    Additionally print the machine-readable result record to stdout. Valid
+//    values are json (single-line JSON object) and csv (header line followed
+//    by the record line). The record includes the method, options, entry
+//    count, total and per-entry times (for the median run if repeated), the
+//    per-entry time statistics and samples (one per repetition), the
+//    per-entry resource usage, the latency percentiles (if --histogram is
+//    specified), thread count, kernel version, and filesystem type. Can not
+//    be combined with -P or -r.
+//
+// --count-allocs
+//    Count the heap allocations made during the measured runs via the
+//    replaced global operator new and print their number, total and per
+//    entry, to stderr. Note that the allocations made by the C library
+//    directly (for example, by opendir()) are not counted.
+//
+// --cold
+//    Evict the caches before each run, warm-up included, so that the
+//    dentry, inode, and page caches are cold. If running as root, then drop
+//    the caches system-wide by writing to /proc/sys/vm/drop_caches (Linux
+//    only). Otherwise, call posix_fadvise(POSIX_FADV_DONTNEED) for the
+//    benchmarked entries and, for iter and diff, the directories traversed.
+//    Note that the latter only evicts the cached file and directory pages
+//    (where supported by the filesystem) but not the dentry and inode
+//    caches. The eviction method used is printed to stderr and included in
+//    the result record (see --format).
+//
+// --perf
+//    Count the CPU cycles, instructions, cache misses, context switches, and
+//    page faults during the measured runs using perf_event_open() and print
+//    them per entry to stderr, next to the time per entry, as well as
+//    include them into the result record (see --format). The counters are
+//    inherited by the worker threads (see -j and --pipeline). If not
+//    permitted by perf_event_paranoid, only the user space is counted and
+//    the context switches (which happen in the kernel) are reported as
+//    unavailable. The events not supported (for example, the hardware
+//    events in a virtual machine) are reported as unavailable as well (Linux
+//    only).
+//
+// -P <level>
+//    If level is not 0, then print the entry paths one per line, optionally
+//    together with their modification/access time (level > 1) to stdout.
+//
+//    On POSIX the output is accumulated in a large buffer and written with
+//    write(2)/writev(2) rather than via iostream, the times are formatted
+//    with a specialized formatter that caches the local date and hour, and
+//    the time spent on listing (formatting and writing) as well as the rest
+//    of the traversal time are additionally printed to stderr.
+//
+// --snapshot <index>
+//    Write the path (relative to the directory), inode, size, and
+//    modification time of each traversed entry, including the directory
+//    itself, into the specified snapshot index file (see diff). The index
+//    is binary, sorted by path, and suitable for memory mapping. Can not be
+//    combined with -j. Note that the entries are collected during the
+//    traversal but are sorted and written after the measurement.
+//
+// --pipeline <workers>
+//    Traverse the directory on the main thread, pushing the entry paths into
+//    a bounded lock-free queue, and stat them on the specified number of
+//    worker threads, so that reading the directories and stating the entries
+//    overlap. Additionally, print the throughput as well as the number of
+//    times and the time the traversal waited for the queue to become
+//    non-full (producer stalls) and each worker waited for it to become
+//    non-empty (consumer stalls) to stderr. Note that the time includes the
+//    workers startup. Can only be used with -o and can not be combined with
+//    -j or -P.
+//
+// --incremental <index>
+//    Rescan the directory incrementally using the snapshot index previously
+//    written with --snapshot. The directories whose own inode and
+//    modification time match the index are not read and their entries are
+//    not stated, except for the sub-directories (known from the index) which
+//    are stated and recursed into. Additionally, print the numbers of the
+//    directories read and pruned as well as the time per entry in the index
+//    and per entry stated, each with its number of entries, to stderr. Note
+//    that otherwise the time per entry is calculated for the number of
+//    entries in the index. Can only be used with -o and can not be combined
+//    with -j or -P.
+//
+// --cpu <list>
+//    Pin the process to the specified CPUs using sched_setaffinity() before
+//    the measurement (and the clock calibration). The list is
+//    comma-separated CPU numbers or <min>-<max> ranges, for example, 0,2-3.
+//    The worker threads (see -j and --pipeline) inherit the affinity and
+//    are thus pinned to the same CPUs (Linux only).
+//
+// --sched <policy>
+//    Switch to the specified scheduling policy before the measurement.
+//    Valid values are fifo (SCHED_FIFO with the minimum real-time priority,
+//    normally requires root), batch (SCHED_BATCH), and idle (SCHED_IDLE).
+//    The worker threads inherit the policy (Linux only).
+//
+// --mlockall
+//    Lock the current and future process memory pages with mlockall() before
+//    the measurement, so that they are not paged out.
+//
+//    The CPU list, scheduling policy, and whether the memory is locked are
+//    printed to stderr and included in the result record (see --format).
+//
+// --null
+//    Separate the entries printed with -P with the NUL character rather than
+//    newline.
+//
+// -j <threads>
+//    For stat, stat the entries on the specified number of threads,
+//    partitioning the entry paths between them according to --shard.
+//    Additionally, print the throughput as well as the number of entries and
+//    the time spent by each thread to stderr.
+//
+//    For iter, traverse the directory on the specified number of threads,
+//    processing each sub-directory as a separate task. Each thread owns a
+//    deque of tasks and steals tasks from the other threads when it runs out
+//    of its own. Additionally, print the number of entries traversed by each
+//    thread to stderr. Note that the time includes the threads startup.
+//
+//    For gen, generate the directories on the specified number of threads
+//    in the same manner. If unspecified, the number of hardware threads is
+//    used.
+//
+// --shard <strategy>
+//    The entry paths partitioning strategy for stat -j. Valid values are
+//    chunk (contiguous chunks of equal size, default), round-robin (path i
+//    is assigned to thread i % <threads>), and dir (paths are grouped by
+//    their parent directories and each group is assigned to a single
+//    thread).
+//
+// --depth <n>
+//    The generated tree depth, 3 by default. Depth 0 means that only the
+//    files are generated in the directory itself.
+//
+// --fanout <n>
+//    The number of sub-directories in each generated directory above the
+//    maximum depth, 8 by default.
+//
+// --files <n>
+//    The number of files (including symlinks) in each generated directory,
+//    16 by default.
+//
+// --name-length <range>
+//    The generated entry name length, either fixed (<n>) or uniformly
+//    distributed in the range (<min>-<max>), 8-16 by default.
+//
+// --size <range>
+//    The generated file size in bytes, either fixed or uniformly distributed
+//    in the range, as for --name-length, 0 by default.
+//
+// --symlinks <ratio>
+//    The ratio (between 0 and 1) of the files which are generated as
+//    symlinks, 0 by default.
+//
+// --seed <n>
+//    The pseudo-random number generator seed, 0 by default.
+//
+// --trim <fraction>
+//    The fraction (0 <= <fraction> < 0.5) of the smallest and largest
+//    samples discarded when calculating the trimmed mean by stats, 0.1 by
+//    default.
+//
+// --threshold <percent>
+//    The relative per-entry time difference considered a change by compare,
+//    5 by default.
+//
+// --alpha <level>
+//    The significance level for compare, 0.05 by default. The confidence
+//    interval is calculated for the 1 - <level> confidence.
+//
+int
+main (int argc, char* argv[])
+{
+  auto usage = [&argv] ()
+  {
+    cerr << "Usage:" << endl
+#ifdef _WIN32
+         << "  " << argv[0] << " stat (-a|-e|-h) [<repeat>] [-r] <file>"
+         << endl
+         << "  " << argv[0] << " iter (-p|-n|-N) [-a|-e|-h] "
+         << "[-P <level>|<repeat>] [-r] <dir>" << endl
+         << "  where <repeat> is [--repeat <n>] [--warmup <n>]" << endl
+#else
+         << "  " << argv[0] << " stat (-s|-x [--mask <fields>]) "
+         << "[-j <threads> [--shard <strategy>]] [<repeat>] [-r] <file>"
+         << endl
+         << "  " << argv[0] << " stat -u [--mask <fields>] "
+         << "[--queue-depth <n>] [--batch <n>] [<repeat>] [-r] <file>" << endl
+         << "  " << argv[0] << " iter (-o|-f|-g [--dirent-buf <bytes>]) "
+         << "[-s|-x [--mask <fields>]] [--order <order>] "
+         << "[-P <level> [--null]|-j <threads>|<repeat>] [-r] <dir>" << endl
+         << "  " << argv[0] << " iter (-o|-f|-g [--dirent-buf <bytes>]) "
+         << "(-s|-x [--mask <fields>]) [--order <order>] --snapshot <index> "
+         << "[-P <level> [--null]|<repeat>] [-r] <dir>" << endl
+         << "  " << argv[0] << " iter -o (-s|-x [--mask <fields>]) "
+         << "--pipeline <workers> [<repeat>] [-r] <dir>" << endl
+         << "  " << argv[0] << " iter -o (-s|-x [--mask <fields>]) "
+         << "--incremental <index> [<repeat>] [-r] <dir>" << endl
+         << "  " << argv[0] << " diff (-o|-f|-g [--dirent-buf <bytes>]) "
+         << "(-s|-x [--mask <fields>]) [--order <order>] "
+         << "[-P <level> [--null]|<repeat>] [-r] <index> <dir>" << endl
+         << "  where <repeat> is [--repeat <n>] [--warmup <n>]" << endl
+         << "  stat, iter, and diff also accept [--clock <clock>] "
+         << "[--histogram] "
+         << "[--histogram-dump <file>] [--format <format>] "
+         << "[--count-allocs] [--cold] [--perf] [--cpu <list>] "
+         << "[--sched <policy>] [--mlockall]" << endl
+         << "  " << argv[0] << " gen [--depth <n>] [--fanout <n>] "
+         << "[--files <n>] [--name-length <range>] [--size <range>] "
+         << "[--symlinks <ratio>] [--seed <n>] [-j <threads>] <dir>" << endl
+#endif
+         << "  " << argv[0] << " stats [--trim <fraction>] [-r] <file>|-"
+         << endl
+         << "  " << argv[0] << " compare [--threshold <percent>] "
+         << "[--alpha <level>] <baseline> <candidate>" << endl;
+
+    throw failed ();
+  };
+
+  try
+  {
+    int i (1);
+
+    if (argc == 1)
+      usage ();
+
+    enum class cmd
+    {
+      stat,
+      iter,
+      gen,
+      diff,
+      stats,
+      compare,
+      none
+    } c (cmd::none);
+
+    string a (argv[i++]);
+
+    if (a == "stat")
+      c = cmd::stat;
+    else if (a == "iter")
+      c = cmd::iter;
+#ifndef _WIN32
+    else if (a == "gen")
+      c = cmd::gen;
+    else if (a == "diff")
+      c = cmd::diff;
+#endif
+    else if (a == "stats")
+      c = cmd::stats;
+    else if (a == "compare")
+      c = cmd::compare;
+    else
+      usage ();
+
+    if (c == cmd::stats)
+    {
+      double trim (0.1);
+      bool print_result (false);
+
+      for (; i != argc; ++i)
+      {
+        string v (argv[i]);
+
+        if (v == "--trim")
+        {
+          if (++i == argc)
+            usage ();
+
+          trim = stod (argv[i]);
+
+          if (trim < 0 || trim >= 0.5)
+            usage ();
+        }
+        else if (v == "-r")
+          print_result = true;
+        else
+          break;
+      }
+
+      if (i != argc - 1)
+        usage ();
+
+      string f (argv[i]);
+
+      ifstream ifs;
+      if (f != "-")
+      {
+        ifs.open (f);
+        if (!ifs.is_open ())
+        {
+          cerr << "error: can't open " << f << endl;
+          throw failed ();
+        }
+      }
+
+      istream& is (f != "-" ? ifs : cin);
+
+      sample_summary s;
+
+      for (string v; is >> v; )
+      {
+        char* e;
+        double d (strtod (v.c_str (), &e));
+
+        if (*e != '\0' || !isfinite (d) || d < 0)
+        {
+          cerr << "error: invalid sample '" << v << "'" << endl;
+          throw failed ();
+        }
+
+        s.add (d);
+      }
+
+      if (is.bad ())
+      {
+        cerr << "error: can't read " << f << endl;
+        throw failed ();
+      }
+
+      if (s.count () == 0)
+      {
+        cerr << "error: no samples" << endl;
+        throw failed ();
+      }
+
+      pair<uint64_t, uint64_t> os (s.outliers (3.5));
+
+      cerr << "samples: " << s.count () << endl
+           << "min: " << exact_string (s.min ()) << endl
+           << "max: " << exact_string (s.max ()) << endl
+           << "mean: " << exact_string (s.mean ()) << endl
+           << "stddev: " << exact_string (s.stddev ()) << endl
+           << "median: " << exact_string (s.median ()) << endl
+           << "MAD: " << exact_string (s.mad ()) << endl
+           << "trimmed mean (" << exact_string (trim * 100) << "%): "
+           << exact_string (s.trimmed_mean (trim)) << endl
+           << "outliers: " << os.first + os.second << " (" << os.first
+           << " low, " << os.second << " high)" << endl;
+
+      if (!s.exact ())
+        cerr << "note: more than " << sample_summary::max_buckets
+             << " distinct samples, median, MAD, trimmed mean, and outliers "
+             << "are approximated with the relative error below 2^-"
+             << s.precision () << endl;
+
+      if (print_result)
+        cout << exact_string (s.median ()) << endl;
+
+      return 0;
+    }
+
+    if (c == cmd::compare)
+    {
+      double threshold (5);
+      double alpha (0.05);
+
+      for (; i != argc; ++i)
+      {
+        string v (argv[i]);
+
+        if (v == "--threshold")
+        {
+          if (++i == argc)
+            usage ();
+
+          threshold = stod (argv[i]);
+
+          if (threshold < 0)
+            usage ();
+        }
+        else if (v == "--alpha")
+        {
+          if (++i == argc)
+            usage ();
+
+          alpha = stod (argv[i]);
+
+          if (alpha <= 0 || alpha >= 1)
+            usage ();
+        }
+        else
+          break;
+      }
+
+      if (i != argc - 2)
+        usage ();
+
+      // Load the records, pooling the samples of the same method and
+      // keeping the methods in the order of appearance.
+      //
+      auto load = [] (const char* f) -> vector<method_samples>
+      {
+        ifstream is (f);
+        if (!is.is_open ())
+        {
+          cerr << "error: can't open " << f << endl;
+          throw failed ();
+        }
+
+        vector<method_samples> r;
+
+        string l;
+        for (size_t ln (1); getline (is, l); ++ln)
+        {
+          if (l.empty ())
+            continue;
+
+          method_samples s;
+          if (!parse_result_record (l, s))
+          {
+            cerr << f << ':' << ln << ": error: invalid result record"
+                 << endl;
+            throw failed ();
+          }
+
+          auto i (find_if (r.begin (), r.end (),
+                           [&s] (const method_samples& m)
+                           {
+                             return m.benchmark == s.benchmark &&
+                                    m.method == s.method;
+                           }));
+
+          if (i != r.end ())
+            i->samples.insert (i->samples.end (),
+                               s.samples.begin (),
+                               s.samples.end ());
+          else
+            r.push_back (move (s));
+        }
+
+        if (is.bad ())
+        {
+          cerr << "error: can't read " << f << endl;
+          throw failed ();
+        }
+
+        return r;
+      };
+
+      vector<method_samples> bs (load (argv[i]));
+      vector<method_samples> cs (load (argv[i + 1]));
+
+      bool regression (false);
+
+      cout << fixed;
+
+      for (const method_samples& b: bs)
+      {
+        auto ci (find_if (cs.begin (), cs.end (),
+                          [&b] (const method_samples& m)
+                          {
+                            return m.benchmark == b.benchmark &&
+                                   m.method == b.method;
+                          }));
+
+        cout << b.benchmark << ' ' << b.method << ':' << endl;
+
+        if (ci == cs.end ())
+        {
+          cout << "  only in baseline" << endl;
+          continue;
+        }
+
+        const method_samples& c (*ci);
+
+        double bm (sample_stats (b.samples).median);
+        double cm (sample_stats (c.samples).median);
+
+        // The relative difference is meaningless for the zero baseline.
+        //
+        if (bm == 0)
+        {
+          cout << "  zero baseline median, not compared" << endl;
+          continue;
+        }
+
+        double d ((cm - bm) / bm * 100);
+
+        pair<double, double> u (mann_whitney (b.samples, c.samples));
+        pair<double, double> r (
+          bootstrap_ci (b.samples, c.samples, 1 - alpha, 10000));
+
+        // Note that the confidence interval must agree with the test (it
+        // may not if, for example, the medians differ but the
+        // distributions are skewed).
+        //
+        const char* v ("no significant change");
+        if (u.second < alpha && abs (d) > threshold)
+        {
+          if (d > 0 && r.first > 0)
+          {
+            v = "regression";
+            regression = true;
+          }
+          else if (d < 0 && r.second < 0)
+            v = "improvement";
+        }
+
+        cout << setprecision (1)
+             << "  baseline:  " << b.samples.size () << " samples, median "
+             << bm << " nanoseconds" << endl
+             << "  candidate: " << c.samples.size () << " samples, median "
+             << cm << " nanoseconds" << endl
+             << "  delta: " << showpos << cm - bm << " nanoseconds (" << d
+             << "%)" << endl
+             << "  " << noshowpos << (1 - alpha) * 100
+             << "% confidence interval: [" << showpos << r.first << "%, "
+             << r.second << "%]" << endl
+             << noshowpos
+             << "  Mann-Whitney U: " << u.first
+             << ", p-value: " << setprecision (4) << u.second << endl
+             << "  verdict: " << v << endl;
+      }
+
+      for (const method_samples& c: cs)
+      {
+        if (find_if (bs.begin (), bs.end (),
+                     [&c] (const method_samples& m)
+                     {
+                       return m.benchmark == c.benchmark &&
+                              m.method == c.method;
+                     }) == bs.end ())
+          cout << c.benchmark << ' ' << c.method << ':' << endl
+               << "  only in candidate" << endl;
+      }
+
+      return regression ? 2 : 0;
+    }
+
+#ifdef _WIN32
+    enum class cmd_stat
+    {
+      none,
+      attrs,
+      attrs_ex,
+      handle
+    } st (cmd_stat::none);
+
+    enum class cmd_iter
+    {
+      none,
+      native,
+      native_ex,
+      posix
+    } it (cmd_iter::none);
+
+    unsigned long print (0);
+    bool print_result (false);
+
+    size_t repeat (1);
+    size_t warmup (0);
+
+    for (; i != argc; ++i)
+    {
+      string v (argv[i]);
+
+      auto sst = [&st, &usage] (cmd_stat v)
+      {
+        if (st != cmd_stat::none)
+          usage ();
+
+        st = v;
+      };
+
+      auto sit = [&it, &usage] (cmd_iter v)
+      {
+        if (it != cmd_iter::none)
+          usage ();
+
+        it = v;
+      };
+
+      if (v == "-a")
+        sst (cmd_stat::attrs);
+      else if (v == "-e")
+        sst (cmd_stat::attrs_ex);
+      else if (v == "-h")
+        sst (cmd_stat::handle);
+      else if (v == "-p")
+        sit (cmd_iter::posix);
+      else if (v == "-n")
+        sit (cmd_iter::native);
+      else if (v == "-N")
+        sit (cmd_iter::native_ex);
+      else if (v == "-P")
+      {
+        if (++i == argc)
+          usage ();
+
+        print = stoul (argv[i]);
+      }
+      else if (v == "-r")
+        print_result = true;
+      else if (v == "--repeat")
+      {
+        if (++i == argc)
+          usage ();
+
+        repeat = stoul (argv[i]);
+
+        if (repeat == 0)
+          usage ();
+      }
+      else if (v == "--warmup")
+      {
+        if (++i == argc)
+          usage ();
+
+        warmup = stoul (argv[i]);
+      }
+      else
+        break;
+    }
+
+    if ((repeat != 1 || warmup != 0) && print != 0)
+      usage ();
+
+    bench_clock::init (false);
+
+    auto tm = [] (const FILETIME& t) -> timestamp
+    {
+      // Time in FILETIME is in 100 nanosecond "ticks" since "Windows epoch"
+      // (1601-01-01T00:00:00Z). To convert it to "UNIX epoch"
+      // (1970-01-01T00:00:00Z) we need to subtract 11644473600 seconds.
+      //
+      uint64_t nsec ((static_cast<uint64_t> (t.dwHighDateTime) << 32) |
+                     t.dwLowDateTime);
+
+      nsec -= 11644473600ULL * 10000000; // Now in UNIX epoch.
+      nsec *= 100;                       // Now in nanoseconds.
+
+      return timestamp (
+        chrono::duration_cast<duration> (chrono::nanoseconds (nsec)));
+    };
+
+    auto entry_tm = [&st, &tm] (const string& p) -> entry_time
+    {
+      switch (st)
+      {
+      case cmd_stat::attrs:
+        {
+          DWORD a (GetFileAttributesA (p.c_str ()));
+          if (a == INVALID_FILE_ATTRIBUTES)
+          {
+            cerr << "error: GetFileAttributesA() failed for " << p << ": "
+                 << last_error_msg () << endl;
+
+            throw failed ();
+          }
+
+          return {timestamp_nonexistent, timestamp_nonexistent};
+        }
+      case cmd_stat::attrs_ex:
+        {
+          WIN32_FILE_ATTRIBUTE_DATA a;
+          if (!GetFileAttributesExA (p.c_str (), GetFileExInfoStandard, &a))
+          {
+            cerr << "error: GetFileAttributesExA() failed for " << p
+                 << ": " << last_error_msg () << endl;
+
+            throw failed ();
+          }
+
+          return {tm (a.ftLastWriteTime), tm (a.ftLastAccessTime)};
+        }
+      case cmd_stat::handle:
+        {
+          auto_handle h (
+            CreateFile (p.c_str (),
+                        0,
+                        0,
+                        nullptr,
+                        OPEN_EXISTING,
+                        FILE_FLAG_BACKUP_SEMANTICS,// Required for a directory.
+                        nullptr));
+
+          if (h == nullhandle)
+          {
+            cerr << "error: CreateFile failed for " << p << ": "
+                 << last_error_msg () << endl;
+
+            throw failed ();
+          }
+
+          BY_HANDLE_FILE_INFORMATION r;
+          if (!GetFileInformationByHandle (h.get (), &r))
+          {
+            cerr << "error: GetFileInformationByHandle() failed for " << p
+                 << ": " << last_error_msg () << endl;
+
+            throw failed ();
+          }
+
+          return {tm (r.ftLastWriteTime), tm (r.ftLastAccessTime)};
+        }
+      case cmd_stat::none: break;
+      }
+
+      assert (false); // Can't be here.
+      return {timestamp_nonexistent, timestamp_nonexistent};
+    };
+
+    switch (c)
+    {
+    case cmd::stat:
+      {
+        if (i != argc - 1 || st == cmd_stat::none)
+          usage ();
+
+        string p (argv[i]);
+
+        ifstream f (p);
+        if (!f.is_open ())
+        {
+          cerr << "error: can't open " << p << endl;
+          throw failed ();
+        }
+
+        f.exceptions (ifstream::badbit);
+
+        vector<string> paths;
+        for (string p; getline (f, p); )
+          paths.push_back (move (p));
+
+        if (!f.eof ())
+        {
+          cerr << "error: can't read " << p << endl;
+          throw failed ();
+        }
+
+        if (paths.empty ())
+        {
+          cerr << "error: no entries in file " << p << endl;
+          throw failed ();
+        }
+
+        auto run = [&paths, &entry_tm] () -> nanoseconds
+        {
+          bench_clock::ticks start_time (bench_clock::now ());
+
+          for (const string& p: paths)
+            entry_tm (p);
+
+          return bench_clock::elapsed (start_time, bench_clock::now ());
+        };
+
+        vector<nanoseconds> ds (measure_runs (warmup, repeat, [] () {}, run));
+        nanoseconds d (report_runs (paths.size (), ds, warmup));
+
+        if (print_result)
+          cout << d.count () / paths.size () << endl;
+
+        break;
+      }
+    case cmd::iter:
+      {
+        if (i != argc - 1 || it == cmd_iter::none)
+          usage ();
+
+        string p (argv[i]);
+
+        // Note that the entries are counted anew on every run.
+        //
+        size_t count (0);
+
+        auto run = [it, &p, &count, st, &tm, &entry_tm, print] ()
+          -> nanoseconds
+        {
+          count = 0;
+          bench_clock::ticks start_time (bench_clock::now ());
+
+          switch (it)
+          {
+          case cmd_iter::posix:
+            {
+              auto iterate = [&count] (const string& d,
+                                       const auto& iterate) -> void
+              {
+                struct auto_dir
+                {
+                  explicit
+                  auto_dir (intptr_t& h): h_ (&h) {}
+
+                  auto_dir (const auto_dir&) = delete;
+                  auto_dir& operator= (const auto_dir&) = delete;
+
+                  ~auto_dir ()
+                  {
+                    if (h_ != nullptr && *h_ != -1)
+                      _findclose (*h_);
+                  }
+
+                  void release () {h_ = nullptr;}
+
+                private:
+                  intptr_t* h_;
+                };
+
+                intptr_t h (-1);
+                auto_dir ad (h);
+
+                for (;;)
+                {
+                  bool r;
+                  _finddata_t fi;
+
+                  if (h == -1)
+                  {
+                    h = _findfirst ((d + "\\*").c_str (), &fi);
+                    r = (h != -1);
+                  }
+                  else
+                    r = (_findnext (h, &fi) == 0);
+
+                  if (r)
+                  {
+                    string p (fi.name);
+
+                    if (p == "." || p == "..")
+                      continue;
+
+                    ++count;
+
+                    if ((fi.attrib & _A_SUBDIR) != 0)
+                      iterate (d + '\\' + p, iterate);
+                  }
+                  else if (errno == ENOENT)
+                  {
+                    // End of stream.
+                    //
+                    if (h != -1)
+                    {
+                      _findclose (h);
+                      h = -1;
+                    }
+
+                    break;
+                  }
+                  else
+                  {
+                    cerr << "error: _find*() failed: " << last_errno_msg ()
+                         << endl;
+                    throw failed ();
+                  }
+                }
+              };
+
+              iterate (p, iterate);
+
+              break;
+            }
+
+          case cmd_iter::native:
+          case cmd_iter::native_ex:
+            {
+              auto iterate = [&count, st, it, &tm, &entry_tm, print]
+                             (const string& d, const auto& iterate) -> void
+              {
+                struct auto_dir
+                {
+                  explicit
+                  auto_dir (HANDLE& h): h_ (&h) {}
+
+                  auto_dir (const auto_dir&) = delete;
+                  auto_dir& operator= (const auto_dir&) = delete;
+
+                  ~auto_dir ()
+                  {
+                    if (h_ != nullptr && *h_ != INVALID_HANDLE_VALUE)
+                      FindClose (*h_);
+                  }
+
+                  void release () {h_ = nullptr;}
+
+                private:
+                  HANDLE* h_;
+                };
+
+                HANDLE h (INVALID_HANDLE_VALUE);
+                auto_dir ad (h);
+
+                for (;;)
+                {
+                  bool r;
+                  WIN32_FIND_DATA fi;
+
+                  if (h == INVALID_HANDLE_VALUE)
+                  {
+                    string p (d + "\\*");
+
+                    if (it == cmd_iter::native)
+                      h = FindFirstFileA (p.c_str (), &fi);
+                    else
+                      h = FindFirstFileExA (p.c_str (),
+                                            FindExInfoBasic,
+                                            &fi,
+                                            FindExSearchNameMatch,
+                                            NULL,
+                                            0);
+
+                    r = (h != INVALID_HANDLE_VALUE);
+                  }
+                  else
+                    r = FindNextFileA (h, &fi);
+
+                  DWORD e (GetLastError ());
+
+                  if (r)
+                  {
+                    string p (fi.cFileName);
+
+                    if (p == "." || p == "..")
+                      continue;
+
+                    ++count;
+
+                    p = d + '\\' + p;
+
+                    bool dir (
+                      (fi.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+
+                    entry_time t {
+                      tm (fi.ftLastWriteTime), tm (fi.ftLastAccessTime)};
+
+                    entry_time et;
+
+                    if (st != cmd_stat::none)
+                    {
+                      et = entry_tm (p);
+
+                      // Note: as per documentation:
+                      //
+                      // The NTFS file system delays updates to the last access
+                      // time for a file by up to 1 hour after the last access
+                      //
+                      if (!(t.modification == et.modification &&
+                            t.access <= et.access))
+                      {
+                        cerr << "error: times mismatch for " << p
+                             << (dir ? "\\" : "") << endl
+                             << "  find: mod " << t.modification
+                             << " acc " << t.access << endl
+                             << "  stat: mod " << et.modification
+                             << " acc " << et.access << endl;
+                        throw failed ();
+                      }
+                    }
+
+                    if (print != 0)
+                    {
+                      cout << p;
+
+                      if (print > 1)
+                      {
+                        cout << ' ' << (dir ? "dir" : "reg") << " mod "
+                             << t.modification << " acc " << t.access;
+
+                        if (st != cmd_stat::none)
+                          cout << " smod " << et.modification << " sacc "
+                               << et.access;
+                      }
+
+                      cout << endl;
+                    }
+
+                    if (dir)
+                      iterate (p, iterate);
+                  }
+                  else if (e == ERROR_FILE_NOT_FOUND ||
+                           e == ERROR_NO_MORE_FILES)
+                  {
+                    // End of stream.
+                    //
+                    if (h != INVALID_HANDLE_VALUE)
+                    {
+                      FindClose (h);
+                      h = INVALID_HANDLE_VALUE;
+                    }
+
+                    break;
+                  }
+                  else
+                  {
+                    cerr << "error: Find*FileA() failed: " << error_msg (e)
+                         << endl;
+                    throw failed ();
+                  }
+                }
+              };
+
+              iterate (p, iterate);
+
+              break;
+            }
+          case cmd_iter::none: break;
+          }
+
+          return bench_clock::elapsed (start_time, bench_clock::now ());
+        };
+
+        vector<nanoseconds> ds (measure_runs (warmup, repeat, [] () {}, run));
+
+        if (count == 0)
+        {
+          cerr << "error: no entries in " << p << endl;
+          throw failed ();
+        }
+
+        nanoseconds d (report_runs (count, ds, warmup));
+
+        if (print_result)
+          cout << d.count () / count << endl;
+
+        break;
+      }
+    case cmd::gen:
+    case cmd::diff:
+    case cmd::stats:
+    case cmd::compare:
+    case cmd::none: assert (false); break; // Can't be here.
+    }
+
+#else
+
+    // Generate the synthetic tree.
+    //
+    if (c == cmd::gen)
+    {
+      size_t depth (3);
+      size_t fanout (8);
+      size_t files (16);
+      uint64_t name_min (8), name_max (16);
+      uint64_t size_min (0), size_max (0);
+      double symlinks (0);
+      uint64_t seed (0);
+      size_t threads (thread::hardware_concurrency ());
+
+      for (; i != argc; ++i)
+      {
+        string v (argv[i]);
+
+        if (v == "--depth")
+        {
+          if (++i == argc)
+            usage ();
+
+          depth = stoul (argv[i]);
+        }
+        else if (v == "--fanout")
+        {
+          if (++i == argc)
+            usage ();
+
+          fanout = stoul (argv[i]);
+        }
+        else if (v == "--files")
+        {
+          if (++i == argc)
+            usage ();
+
+          files = stoul (argv[i]);
+        }
+        else if (v == "--name-length")
+        {
+          if (++i == argc)
+            usage ();
+
+          if (!parse_gen_range (argv[i], name_min, name_max) ||
+              name_min == 0                                  ||
+              name_max > 255)
+          {
+            cerr << "error: invalid name length '" << argv[i] << "'" << endl;
+            throw failed ();
+          }
+        }
+        else if (v == "--size")
+        {
+          if (++i == argc)
+            usage ();
+
+          if (!parse_gen_range (argv[i], size_min, size_max))
+          {
+            cerr << "error: invalid size '" << argv[i] << "'" << endl;
+            throw failed ();
+          }
+        }
+        else if (v == "--symlinks")
+        {
+          if (++i == argc)
+            usage ();
+
+          symlinks = stod (argv[i]);
+
+          if (symlinks < 0 || symlinks > 1)
+            usage ();
+        }
+        else if (v == "--seed")
+        {
+          if (++i == argc)
+            usage ();
+
+          seed = stoull (argv[i]);
+        }
+        else if (v == "-j")
+        {
+          if (++i == argc)
+            usage ();
+
+          threads = stoul (argv[i]);
+
+          if (threads == 0)
+            usage ();
+        }
+        else
+          break;
+      }
+
+      if (i + 1 != argc)
+        usage ();
+
+      if (threads == 0)
+        threads = 1;
+
+      string root (argv[i]);
+
+      if (mkdir (root.c_str (), 0777) != 0)
+      {
+        cerr << "error: unable to create directory " << root << ": "
+             << last_errno_msg () << endl;
+        throw failed ();
+      }
+
+      struct task
+      {
+        string path;
+        uint64_t seed;
+        size_t depth;
+      };
+
+      atomic<size_t> dir_count (1);
+      atomic<size_t> file_count (0);
+      atomic<size_t> symlink_count (0);
+      atomic<uint64_t> byte_count (0);
+
+      // Note that the content of each directory is determined by its seed
+      // alone (which is derived from the parent directory seed and the
+      // directory index) and so doesn't depend on the processing order.
+      //
+      auto generate = [depth,
+                       fanout,
+                       files,
+                       name_min, name_max,
+                       size_min, size_max,
+                       symlinks,
+                       &dir_count,
+                       &file_count,
+                       &symlink_count,
+                       &byte_count] (work_stealing_pool<task>& pool,
+                                     size_t w,
+                                     const task& t)
+      {
+        auto fail = [&t] (const char* what, const string& n)
+        {
+          cerr << "error: unable to create " << what << ' ' << t.path << '/'
+               << n << ": " << last_errno_msg () << endl;
+          throw failed ();
+        };
+
+        int fd (open (t.path.c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+
+        if (fd == -1)
+        {
+          cerr << "error: unable to open directory " << t.path << ": "
+               << last_errno_msg () << endl;
+          throw failed ();
+        }
+
+        struct fd_closer
+        {
+          int fd;
+          ~fd_closer () {close (fd);}
+        } fc {fd};
+
+        gen_random r (t.seed);
+        unordered_set<string> names;
+
+        auto name = [&r, &names, name_min, name_max, &t] () -> string
+        {
+          static const char chars[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+
+          // Give up if the names are too short to be unique.
+          //
+          for (size_t a (0); a != 1000; ++a)
+          {
+            string n (r.range (name_min, name_max), '\0');
+
+            for (char& c: n)
+              c = chars[r.next () % (sizeof (chars) - 1)];
+
+            if (names.insert (n).second)
+              return n;
+          }
+
+          cerr << "error: unable to generate unique name in " << t.path
+               << ": name length too short" << endl;
+          throw failed ();
+        };
+
+        if (t.depth != depth)
+        {
+          for (size_t i (0); i != fanout; ++i)
+          {
+            string n (name ());
+
+            if (mkdirat (fd, n.c_str (), 0777) != 0)
+              fail ("directory", n);
+
+            pool.push (w, task {t.path + '/' + n,
+                                gen_random::derive (t.seed, i),
+                                t.depth + 1});
+          }
+
+          dir_count.fetch_add (fanout, memory_order_relaxed);
+        }
+
+        static const char zeros[64 * 1024] = {};
+
+        vector<string> regular;
+        size_t syms (0);
+        uint64_t bytes (0);
+
+        for (size_t i (0); i != files; ++i)
+        {
+          string n (name ());
+
+          if (r.chance (symlinks) && !regular.empty ())
+          {
+            const string& p (regular[r.next () % regular.size ()]);
+
+            if (symlinkat (p.c_str (), fd, n.c_str ()) != 0)
+              fail ("symlink", n);
+
+            ++syms;
+            continue;
+          }
+
+          uint64_t s (r.range (size_min, size_max));
+
+          int f (openat (fd,
+                         n.c_str (),
+                         O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                         0666));
+
+          if (f == -1)
+            fail ("file", n);
+
+          for (uint64_t k (s); k != 0; )
+          {
+            ssize_t c (write (f, zeros, min<uint64_t> (k, sizeof (zeros))));
+
+            if (c == -1)
+            {
+              if (errno == EINTR)
+                continue;
+
+              close (f);
+              fail ("file", n);
+            }
+
+            k -= c;
+          }
+
+          if (close (f) != 0)
+            fail ("file", n);
+
+          bytes += s;
+          regular.push_back (move (n));
+        }
+
+        file_count.fetch_add (regular.size (), memory_order_relaxed);
+        symlink_count.fetch_add (syms, memory_order_relaxed);
+        byte_count.fetch_add (bytes, memory_order_relaxed);
+      };
+
+      steady_clock::time_point start_time (steady_clock::now ());
+
+      work_stealing_pool<task> pool (threads);
+      pool.push (0, task {root, gen_random::derive (seed, 0), 0});
+
+      pool.run ([&pool, &generate] (size_t w, const task& t)
+                {
+                  generate (pool, w, t);
+                },
+                [] (size_t) {});
+
+      nanoseconds d (steady_clock::now () - start_time);
+
+      cerr << "directories: " << dir_count << endl
+           << "files: " << file_count << endl
+           << "symlinks: " << symlink_count << endl
+           << "bytes: " << byte_count << endl
+           << "threads: " << threads << endl
+           << "time: " << d << endl;
+
+      return 0;
+    }
+
+    enum class cmd_stat
+    {
+      none,
+      stat,
+      statx,
+      uring
+    } st (cmd_stat::none);
+
+    enum class cmd_iter
+    {
+      none,
+      opendir,
+      openat,
+      getdents
+    } it (cmd_iter::none);
+
+    unsigned long print (0);
+    bool print_result (false);
+
+    size_t threads (0);
+    size_t repeat (1);
+    size_t warmup (0);
+    bool tsc (false);
+    bool count_allocs (false);
+    bool null_sep (false);
+    string histogram_dump;
+    string snapshot;
+    string incremental;
+    size_t pipeline (0);
+
+    enum class format
+    {
+      text,
+      json,
+      csv
+    } fmt (format::text);
+
+    enum class order
+    {
+      dfs,
+      bfs,
+      inode
+    } ord (order::dfs);
+
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO (&cpus);
+#endif
+    string cpu_list;
+
+    enum class sched_policy
+    {
+      none,
+      fifo,
+      batch,
+      idle
+    } sched (sched_policy::none);
+
+    bool lock_memory (false);
+
+    enum class eviction
+    {
+      none,
+      drop_caches,
+      fadvise
+    } evict (eviction::none);
+
+    bool cold (false);
+
+#ifdef STAT_BENCHMARK_PERF
+    bool perf (false);
+#endif
+
+    enum class shard
+    {
+      chunk,
+      round_robin,
+      dir
+    } sh (shard::chunk);
+    bool shard_specified (false);
+
+#ifdef __linux__
+    size_t dirent_buf (32 * 1024);
+    bool dirent_buf_specified (false);
+#endif
+
+#ifdef STAT_BENCHMARK_STATX
+    unsigned int statx_mask (STATX_MTIME | STATX_ATIME);
+    int statx_flags (0);
+    bool statx_mask_specified (false);
+#endif
+
+#ifdef STAT_BENCHMARK_IO_URING
+    unsigned queue_depth (64);
+    unsigned batch (0); // Queue depth, if unspecified.
+    bool queue_depth_specified (false);
+    bool batch_specified (false);
+#endif
+
+    for (; i != argc; ++i)
+    {
+      string v (argv[i]);
+
+      auto sst = [&st, &usage] (cmd_stat v)
+      {
+        if (st != cmd_stat::none)
+          usage ();
+
+        st = v;
+      };
+
+      auto sit = [&it, &usage] (cmd_iter v)
+      {
+        if (it != cmd_iter::none)
+          usage ();
+
+        it = v;
+      };
+
+      if (v == "-s")
+        sst (cmd_stat::stat);
+#ifdef STAT_BENCHMARK_STATX
+      else if (v == "-x")
+        sst (cmd_stat::statx);
+      else if (v == "--mask")
+      {
+        if (++i == argc)
+          usage ();
+
+        if (!parse_statx_mask (argv[i], statx_mask, statx_flags))
+        {
+          cerr << "error: invalid statx() mask '" << argv[i] << "'" << endl;
+          throw failed ();
+        }
+
+        statx_mask_specified = true;
+      }
+#endif
+#ifdef STAT_BENCHMARK_IO_URING
+      else if (v == "-u")
+        sst (cmd_stat::uring);
+      else if (v == "--queue-depth")
+      {
+        if (++i == argc)
+          usage ();
+
+        queue_depth = static_cast<unsigned> (stoul (argv[i]));
+
+        if (queue_depth == 0)
+          usage ();
+
+        queue_depth_specified = true;
+      }
+      else if (v == "--batch")
+      {
+        if (++i == argc)
+          usage ();
+
+        batch = static_cast<unsigned> (stoul (argv[i]));
+
+        if (batch == 0)
+          usage ();
+
+        batch_specified = true;
+      }
+#endif
+      else if (v == "-o")
+        sit (cmd_iter::opendir);
+      else if (v == "-f")
+        sit (cmd_iter::openat);
+#ifdef __linux__
+      else if (v == "-g")
+        sit (cmd_iter::getdents);
+      else if (v == "--dirent-buf")
+      {
+        if (++i == argc)
+          usage ();
+
+        dirent_buf = stoul (argv[i]);
+
+        // Make sure the buffer can fit at least one entry with the longest
+        // name.
+        //
+        if (dirent_buf < 512)
+        {
+          cerr << "error: directory entry buffer size must be at least 512 "
+               << "bytes" << endl;
+          throw failed ();
+        }
+
+        dirent_buf_specified = true;
+      }
+#endif
+      else if (v == "-P")
+      {
+        if (++i == argc)
+          usage ();
+
+        print = stoul (argv[i]);
+      }
+      else if (v == "--null")
+        null_sep = true;
+      else if (v == "--snapshot")
+      {
+        if (++i == argc)
+          usage ();
+
+        snapshot = argv[i];
+      }
+      else if (v == "--pipeline")
+      {
+        if (++i == argc)
+          usage ();
+
+        pipeline = stoul (argv[i]);
+
+        if (pipeline == 0)
+          usage ();
+      }
+      else if (v == "--incremental")
+      {
+        if (++i == argc)
+          usage ();
+
+        incremental = argv[i];
+      }
+      else if (v == "--order")
+      {
+        if (++i == argc)
+          usage ();
+
+        string s (argv[i]);
+
+        if (s == "dfs")
+          ord = order::dfs;
+        else if (s == "bfs")
+          ord = order::bfs;
+        else if (s == "inode")
+          ord = order::inode;
+        else
+          usage ();
+      }
+      else if (v == "-r")
+        print_result = true;
+      else if (v == "-j")
+      {
+        if (++i == argc)
+          usage ();
+
+        threads = stoul (argv[i]);
+
+        if (threads == 0)
+          usage ();
+      }
+      else if (v == "--repeat")
+      {
+        if (++i == argc)
+          usage ();
+
+        repeat = stoul (argv[i]);
+
+        if (repeat == 0)
+          usage ();
+      }
+      else if (v == "--warmup")
+      {
+        if (++i == argc)
+          usage ();
+
+        warmup = stoul (argv[i]);
+      }
+      else if (v == "--format")
+      {
+        if (++i == argc)
+          usage ();
+
+        string s (argv[i]);
+
+        if (s == "json")
+          fmt = format::json;
+        else if (s == "csv")
+          fmt = format::csv;
+        else
+          usage ();
+      }
+      else if (v == "--histogram")
+        latency_enabled = true;
+      else if (v == "--count-allocs")
+        count_allocs = true;
+      else if (v == "--cold")
+        cold = true;
+#ifdef STAT_BENCHMARK_PERF
+      else if (v == "--perf")
+        perf = true;
+#endif
+#ifdef __linux__
+      else if (v == "--cpu")
+      {
+        if (++i == argc)
+          usage ();
+
+        cpu_list = argv[i];
+
+        CPU_ZERO (&cpus);
+
+        for (size_t b (0), e; b <= cpu_list.size (); b = e + 1)
+        {
+          e = cpu_list.find (',', b);
+          if (e == string::npos)
+            e = cpu_list.size ();
+
+          uint64_t min, max;
+          if (!parse_gen_range (cpu_list.substr (b, e - b), min, max) ||
+              max >= CPU_SETSIZE)
+          {
+            cerr << "error: invalid CPU list '" << cpu_list << "'" << endl;
+            throw failed ();
+          }
+
+          for (uint64_t c (min); c <= max; ++c)
+            CPU_SET (c, &cpus);
+        }
+      }
+      else if (v == "--sched")
+      {
+        if (++i == argc)
+          usage ();
+
+        string s (argv[i]);
+
+        if (s == "fifo")
+          sched = sched_policy::fifo;
+        else if (s == "batch")
+          sched = sched_policy::batch;
+        else if (s == "idle")
+          sched = sched_policy::idle;
+        else
+          usage ();
+      }
+#endif
+      else if (v == "--mlockall")
+        lock_memory = true;
+      else if (v == "--histogram-dump")
+      {
+        if (++i == argc)
+          usage ();
+
+        histogram_dump = argv[i];
+        latency_enabled = true;
+      }
+      else if (v == "--clock")
+      {
+        if (++i == argc)
+          usage ();
+
+        string s (argv[i]);
+
+        if (s == "steady")
+          tsc = false;
+#ifdef STAT_BENCHMARK_TSC
+        else if (s == "tsc")
+          tsc = true;
+#endif
+        else
+          usage ();
+      }
+      else if (v == "--shard")
+      {
+        if (++i == argc)
+          usage ();
+
+        string s (argv[i]);
+
+        if (s == "chunk")
+          sh = shard::chunk;
+        else if (s == "round-robin")
+          sh = shard::round_robin;
+        else if (s == "dir")
+          sh = shard::dir;
+        else
+          usage ();
+
+        shard_specified = true;
+      }
+      else
+        break;
+    }
+
+    // The first positional argument (the options end).
+    //
+    const int options_end (i);
+
+    if (threads != 0 && c == cmd::iter && print != 0)
+      usage ();
+
+    // Note that the entries are recorded (--snapshot) or compared (diff)
+    // serially only.
+    //
+    bool track (!snapshot.empty () || c == cmd::diff);
+
+    if (!snapshot.empty () && c != cmd::iter)
+      usage ();
+
+    if (track && (threads != 0 || st == cmd_stat::none))
+      usage ();
+
+    if (pipeline != 0 &&
+        (c != cmd::iter             ||
+         it != cmd_iter::opendir    ||
+         st == cmd_stat::none       ||
+         threads != 0               ||
+         print != 0                 ||
+         track                      ||
+         !incremental.empty ()))
+      usage ();
+
+    if (!incremental.empty () &&
+        (c != cmd::iter             ||
+         it != cmd_iter::opendir    ||
+         st == cmd_stat::none       ||
+         threads != 0               ||
+         print != 0                 ||
+         !snapshot.empty ()))
+      usage ();
+
+    if (ord != order::dfs &&
+        ((c != cmd::iter && c != cmd::diff) ||
+         threads != 0                       ||
+         pipeline != 0                      ||
+         !incremental.empty ()))
+      usage ();
+
+    if ((repeat != 1 || warmup != 0) && print != 0)
+      usage ();
+
+    if (null_sep && print == 0)
+      usage ();
+
+    // Note that the record is printed to stdout.
+    //
+    if (fmt != format::text && (print != 0 || print_result))
+      usage ();
+
+    // Note that the CPU affinity and scheduling policy of the calling thread
+    // are inherited by the threads it creates.
+    //
+#ifdef __linux__
+    if (!cpu_list.empty ())
+    {
+      if (sched_setaffinity (0, sizeof (cpus), &cpus) != 0)
+      {
+        cerr << "error: sched_setaffinity() failed: " << last_errno_msg ()
+             << endl;
+        throw failed ();
+      }
+
+      cerr << "cpus: " << cpu_list << endl;
+    }
+#endif
+
+    auto sched_name = [sched] () -> const char*
+    {
+      switch (sched)
+      {
+      case sched_policy::fifo:  return "fifo";
+      case sched_policy::batch: return "batch";
+      case sched_policy::idle:  return "idle";
+      case sched_policy::none:  break;
+      }
+
+      return nullptr;
+    };
+
+#ifdef __linux__
+    if (sched != sched_policy::none)
+    {
+      int p (sched == sched_policy::fifo  ? SCHED_FIFO  :
+             sched == sched_policy::batch ? SCHED_BATCH :
+                                            SCHED_IDLE);
+
+      sched_param sp {};
+      sp.sched_priority = p == SCHED_FIFO ? sched_get_priority_min (p) : 0;
+
+      if (sched_setscheduler (0, p, &sp) != 0)
+      {
+        cerr << "error: sched_setscheduler() failed: " << last_errno_msg ()
+             << endl;
+        throw failed ();
+      }
+
+      cerr << "scheduling policy: " << sched_name () << endl;
+    }
+#endif
+
+    if (lock_memory)
+    {
+      if (mlockall (MCL_CURRENT | MCL_FUTURE) != 0)
+      {
+        cerr << "error: mlockall() failed: " << last_errno_msg () << endl;
+        throw failed ();
+      }
+
+      cerr << "memory locked" << endl;
+    }
+
+    // Note that the counters are only inherited by the threads created
+    // after they are opened.
+    //
+#ifdef STAT_BENCHMARK_PERF
+    if (perf)
+      perf_collected.emplace ();
+#endif
+
+    bench_clock::init (tsc);
+
+    // Prefer dropping the caches system-wide if we can (--cold).
+    //
+    if (cold)
+    {
+#ifdef __linux__
+      if (geteuid () == 0 && access ("/proc/sys/vm/drop_caches", W_OK) == 0)
+        evict = eviction::drop_caches;
+#endif
+
+#ifdef POSIX_FADV_DONTNEED
+      if (evict == eviction::none)
+        evict = eviction::fadvise;
+#endif
+
+      if (evict == eviction::none)
+      {
+        cerr << "error: no cache eviction method available" << endl;
+        throw failed ();
+      }
+
+      cerr << "cache eviction: "
+           << (evict == eviction::drop_caches ? "drop_caches" : "fadvise")
+           << endl;
+    }
+
+    if (shard_specified && (c != cmd::stat || threads == 0))
+      usage ();
+
+#ifdef STAT_BENCHMARK_STATX
+    if (statx_mask_specified &&
+        st != cmd_stat::statx &&
+        st != cmd_stat::uring)
+      usage ();
+#endif
+
+#ifdef STAT_BENCHMARK_IO_URING
+    if ((queue_depth_specified || batch_specified) && st != cmd_stat::uring)
+      usage ();
+
+    if (batch == 0)
+      batch = queue_depth;
+
+    if (st == cmd_stat::uring &&
+        (c != cmd::stat || threads != 0 || batch > queue_depth))
+      usage ();
+#endif
+
+#ifdef __linux__
+    if (dirent_buf_specified && it != cmd_iter::getdents)
+      usage ();
+#endif
+
+#ifdef STAT_BENCHMARK_STATX
+    if (track || !incremental.empty ())
+      statx_mask |= STATX_TYPE | STATX_INO | STATX_SIZE | STATX_MTIME;
+#endif
+
+    auto tm = [] (time_t sec, auto nsec) -> timestamp
+    {
+      return system_clock::from_time_t (sec) +
+             chrono::duration_cast<duration> (chrono::nanoseconds (nsec));
+    };
+
+    // Stat the entry path which, unless fd is AT_FDCWD, is relative to the
+    // directory referred to by the file descriptor. If info is not NULL,
+    // then also retrieve the additional entry information.
+    //
+#ifdef STAT_BENCHMARK_STATX
+    auto entry_tm_at = [&st, &tm, statx_mask, statx_flags]
+                       (int fd, const char* p, entry_info* info = nullptr)
+      -> entry_time
+#else
+    auto entry_tm_at = [&st, &tm]
+                       (int fd, const char* p, entry_info* info = nullptr)
+      -> entry_time
+#endif
+    {
+      switch (st)
+      {
+      case cmd_stat::stat:
+        {
+          struct stat s;
+          if ((fd == AT_FDCWD
+               ? stat (p, &s)
+               : fstatat (fd, p, &s, 0)) != 0)
+          {
+            if (errno == ENOENT || errno == ENOTDIR)
+            {
+              return {timestamp_nonexistent, timestamp_nonexistent};
+            }
+            else
+            {
+              cerr << "error: stat() failed for " << p
+                   << ": " << last_errno_msg () << endl;
+
+              throw failed ();
+            }
+          }
+
+          if (info != nullptr)
+          {
+            info->ino = static_cast<uint64_t> (s.st_ino);
+            info->size = static_cast<uint64_t> (s.st_size);
+            info->mode = static_cast<uint32_t> (s.st_mode);
+          }
+
+          return {tm (s.st_mtime, mnsec<struct stat> (&s, true)),
+                  tm (s.st_atime, ansec<struct stat> (&s, true))};
+        }
+      case cmd_stat::statx:
+        {
+#ifdef STAT_BENCHMARK_STATX
+          struct statx s;
+          if (statx (fd, p, statx_flags, statx_mask, &s) != 0)
+          {
+            if (errno == ENOENT || errno == ENOTDIR)
+            {
+              return {timestamp_nonexistent, timestamp_nonexistent};
+            }
+            else
+            {
+              cerr << "error: statx() failed for " << p
+                   << ": " << last_errno_msg () << endl;
+
+              throw failed ();
+            }
+          }
+
+          // Note that the filesystem may not support some of the requested
+          // fields or may return some which were not requested.
+          //
+          if (info != nullptr)
+          {
+            info->ino = (s.stx_mask & STATX_INO) != 0 ? s.stx_ino : 0;
+            info->size = (s.stx_mask & STATX_SIZE) != 0 ? s.stx_size : 0;
+            info->mode = (s.stx_mask & STATX_TYPE) != 0 ? s.stx_mode : 0;
+          }
+
+          return {(s.stx_mask & STATX_MTIME) != 0
+                  ? tm (s.stx_mtime.tv_sec, s.stx_mtime.tv_nsec)
+                  : timestamp_unknown,
+                  (s.stx_mask & STATX_ATIME) != 0
+                  ? tm (s.stx_atime.tv_sec, s.stx_atime.tv_nsec)
+                  : timestamp_unknown};
+#else
+          break;
+#endif
+        }
+      case cmd_stat::uring: break; // Not used per entry.
+      case cmd_stat::none: break;
+      }
+
+      assert (false); // Can't be here.
+      return {timestamp_nonexistent, timestamp_nonexistent};
+    };
+
+    auto stat_method = [st] () -> string
+    {
+      switch (st)
+      {
+      case cmd_stat::stat:  return "stat";
+      case cmd_stat::statx: return "statx";
+      case cmd_stat::uring: return "io_uring";
+      case cmd_stat::none:  break;
+      }
+
+      return "none";
+    };
+
+    auto iter_method = [it] () -> string
+    {
+      switch (it)
+      {
+      case cmd_iter::opendir:  return "opendir";
+      case cmd_iter::openat:   return "openat";
+      case cmd_iter::getdents: return "getdents64";
+      case cmd_iter::none:     break;
+      }
+
+      return "none";
+    };
+
+    // Perform the warm-up runs followed by the measured runs and return the
+    // times spent by the latter.
+    //
+    // Note that the latency histograms are only collected for the measured
+    // runs.
+    //
+    // Note that only the allocations made by the measured runs are counted
+    // (--count-allocs).
+    //
+    // Note that the resource usage is collected for the measured runs and
+    // for the whole process rather than the calling thread, so that the
+    // worker threads are accounted for.
+    //
+    // If requested, evict the caches before each run (--cold), calling
+    // evict_pages() if they can't be dropped system-wide.
+    //
+    auto measure = [warmup, repeat, count_allocs, evict]
+                   (const auto& run, const auto& evict_pages)
+      -> vector<nanoseconds>
+    {
+      auto evict_caches = [evict, &evict_pages] ()
+      {
+        switch (evict)
+        {
+        case eviction::drop_caches: drop_caches (); break;
+        case eviction::fadvise:     evict_pages (); break;
+        case eviction::none:        break;
+        }
+      };
+
+      bool measured (false);
+
+      auto start = [&measured] ()
+      {
+        latency_flush ();
+        latency_collected.clear ();
+
+        alloc_count = 0;
+        usage_collected = usage_counters ();
+
+        measured = true;
+      };
+
+      auto once = [&evict_caches, &run, &measured, count_allocs] ()
+        -> nanoseconds
+      {
+        evict_caches ();
+
+        if (!measured)
+          return run ();
+
+        rusage ub (process_usage ());
+
+#ifdef STAT_BENCHMARK_PERF
+        if (perf_collected)
+          perf_collected->start ();
+#endif
+
+        alloc_counting = count_allocs;
+        nanoseconds d (run ());
+        alloc_counting = false;
+
+#ifdef STAT_BENCHMARK_PERF
+        if (perf_collected)
+          perf_collected->stop ();
+#endif
+
+        usage_collected.add (ub, process_usage ());
+
+        latency_flush ();
+        return d;
+      };
+
+      return measure_runs (warmup, repeat, start, once);
+    };
+
+    // Print the collected latency histograms to stderr and optionally dump
+    // their buckets into the file.
+    //
+    auto report_latency = [&histogram_dump] ()
+    {
+      if (!latency_enabled)
+        return;
+
+      print_latency ("stat", latency_collected.stat);
+      print_latency ("read", latency_collected.read);
+
+      if (!histogram_dump.empty ())
+      {
+        ofstream f (histogram_dump);
+        if (!f.is_open ())
+        {
+          cerr << "error: can't open " << histogram_dump << endl;
+          throw failed ();
+        }
+
+        latency_collected.stat.dump (f, "stat");
+        latency_collected.read.dump (f, "read");
+
+        if (!f)
+        {
+          cerr << "error: can't write " << histogram_dump << endl;
+          throw failed ();
+        }
+      }
+    };
+
+    // Print the result record to stdout in the requested format, if any.
+    // The method is the benchmarked method and the path is the entry (or
+    // directory) used to determine the filesystem type.
+    //
+    auto report_record = [fmt,
+                          warmup,
+                          threads,
+                          tsc,
+                          count_allocs,
+                          evict,
+                          &cpu_list,
+                          &sched_name,
+                          lock_memory,
+                          options_end,
+                          argv]
+                         (const char* benchmark,
+                          const string& method,
+                          size_t n,
+                          const vector<nanoseconds>& ds,
+                          nanoseconds d,
+                          const string& path)
+    {
+      if (fmt == format::text)
+        return;
+
+      // Options are all the arguments between the command and the
+      // positional arguments.
+      //
+      string os;
+      for (int i (2); i != options_end; ++i)
+      {
+        if (!os.empty ())
+          os += ' ';
+
+        os += argv[i];
+      }
+
+      vector<double> es;
+      for (const nanoseconds& d: ds)
+        es.push_back (static_cast<double> (d.count ()) / n);
+
+      sample_stats s (es);
+
+      result_record r;
+
+      r.add ("benchmark", benchmark);
+      r.add ("method", method);
+      r.add ("options", os);
+      r.add ("entries", static_cast<uint64_t> (n));
+      r.add ("repetitions", static_cast<uint64_t> (ds.size ()));
+      r.add ("warmup", static_cast<uint64_t> (warmup));
+      r.add ("threads", static_cast<uint64_t> (threads != 0 ? threads : 1));
+      r.add ("clock", tsc ? "tsc" : "steady");
+
+      if (!cpu_list.empty ())
+        r.add ("cpus", cpu_list);
+      else
+        r.add_null ("cpus");
+
+      if (const char* s = sched_name ())
+        r.add ("sched", s);
+      else
+        r.add_null ("sched");
+
+      r.add ("mlockall", lock_memory);
+
+      if (evict != eviction::none)
+        r.add ("cache_eviction",
+               evict == eviction::drop_caches ? "drop_caches" : "fadvise");
+      else
+        r.add_null ("cache_eviction");
+
+      r.add ("total_ns", static_cast<uint64_t> (d.count ()));
+      r.add ("per_entry_ns", static_cast<double> (d.count ()) / n);
+      r.add ("per_entry_min_ns", s.min);
+      r.add ("per_entry_median_ns", s.median);
+      r.add ("per_entry_mean_ns", s.mean);
+      r.add ("per_entry_p90_ns", s.p90);
+      r.add ("per_entry_p99_ns", s.p99);
+      r.add ("per_entry_stddev_ns", s.stddev);
+      r.add ("per_entry_samples_ns", es);
+
+      auto add_latency = [&r] (const char* n, const histogram& h)
+      {
+        static const pair<const char*, double> ps[] = {
+          {"p50", 0.5}, {"p90", 0.9}, {"p99", 0.99}, {"p999", 0.999}};
+
+        for (const auto& p: ps)
+        {
+          string f (string (n) + "_latency_" + p.first + "_ns");
+
+          if (h.total () != 0)
+            r.add (f.c_str (), h.percentile (p.second));
+          else
+            r.add_null (f.c_str ());
+        }
+      };
+
+      add_latency ("stat", latency_collected.stat);
+      add_latency ("read", latency_collected.read);
+
+      {
+        const usage_counters& u (usage_collected);
+        double en (static_cast<double> (ds.size () * n));
+
+        r.add ("user_time_per_entry_ns", u.user.count () / en);
+        r.add ("system_time_per_entry_ns", u.system.count () / en);
+        r.add ("voluntary_switches_per_entry", u.voluntary_switches / en);
+        r.add ("involuntary_switches_per_entry",
+               u.involuntary_switches / en);
+        r.add ("major_faults_per_entry", u.major_faults / en);
+        r.add ("minor_faults_per_entry", u.minor_faults / en);
+      }
+
+      if (count_allocs)
+        r.add ("allocs_per_entry",
+               static_cast<double> (alloc_count) / (ds.size () * n));
+      else
+        r.add_null ("allocs_per_entry");
+
+      for (size_t i (0); i != perf_event_count; ++i)
+      {
+        string f ("perf_" + string (perf_event_names[i]) + "_per_entry");
+        replace (f.begin (), f.end (), ' ', '_');
+
+#ifdef STAT_BENCHMARK_PERF
+        perf_event e (static_cast<perf_event> (i));
+
+        if (perf_collected && perf_collected->available (e))
+        {
+          r.add (f.c_str (),
+                 perf_collected->value (e) / (ds.size () * n));
+          continue;
+        }
+#endif
+        r.add_null (f.c_str ());
+      }
+
+      r.add ("kernel", kernel_version ());
+      r.add ("filesystem", filesystem_type (path));
+
+      if (fmt == format::json)
+        r.print_json (cout);
+      else
+        r.print_csv (cout);
+    };
+
+    // Print the statistics for the measured runs over the specified number of
+    // entries to stderr and return the representative (median, if repeated)
+    // time.
+    //
+    auto report = [warmup, count_allocs] (size_t n,
+                                          const vector<nanoseconds>& ds)
+      -> nanoseconds
+    {
+      auto report_allocs = [count_allocs, n, &ds] ()
+      {
+        if (!count_allocs)
+          return;
+
+        ostream::fmtflags fl (cerr.flags ());
+        streamsize pr (cerr.precision ());
+
+        cerr << "allocations: " << alloc_count << endl
+             << "allocations per entry: " << fixed << setprecision (3)
+             << static_cast<double> (alloc_count) / (ds.size () * n) << endl;
+
+        cerr.flags (fl);
+        cerr.precision (pr);
+      };
+
+      auto report_usage = [n, &ds] ()
+      {
+        const usage_counters& u (usage_collected);
+        double r (static_cast<double> (ds.size () * n));
+
+        ostream::fmtflags fl (cerr.flags ());
+        streamsize pr (cerr.precision ());
+
+        cerr << fixed << setprecision (1)
+             << "user time per entry: " << u.user.count () / r
+             << " nanoseconds" << endl
+             << "system time per entry: " << u.system.count () / r
+             << " nanoseconds" << endl
+             << setprecision (3)
+             << "voluntary context switches per entry: "
+             << u.voluntary_switches / r << endl
+             << "involuntary context switches per entry: "
+             << u.involuntary_switches / r << endl
+             << "major faults per entry: " << u.major_faults / r << endl
+             << "minor faults per entry: " << u.minor_faults / r << endl;
+
+        cerr.flags (fl);
+        cerr.precision (pr);
+      };
+
+      auto report_perf = [n, &ds] ()
+      {
+#ifdef STAT_BENCHMARK_PERF
+        if (!perf_collected)
+          return;
+
+        const perf_counters& pc (*perf_collected);
+
+        ostream::fmtflags fl (cerr.flags ());
+        streamsize pr (cerr.precision ());
+
+        cerr << "perf counting: " << (pc.kernel () ? "user+kernel" : "user")
+             << endl
+             << fixed << setprecision (3);
+
+        for (size_t i (0); i != perf_event_count; ++i)
+        {
+          perf_event e (static_cast<perf_event> (i));
+
+          cerr << perf_event_names[i] << " per entry: ";
+
+          if (pc.available (e))
+            cerr << pc.value (e) / (ds.size () * n) << endl;
+          else
+            cerr << "unavailable" << endl;
+        }
+
+        cerr.flags (fl);
+        cerr.precision (pr);
+#else
+        (void) n;
+        (void) ds;
+#endif
+      };
+
+      nanoseconds d (report_runs (n, ds, warmup));
+
+      report_usage ();
+      report_perf ();
+      report_allocs ();
+      return d;
     };
 
-    auto entry_tm = [&st, &tm] (const string& p) -> entry_time
-    {
-      switch (st)
-      {
-      case cmd_stat::attrs:
+    switch (c)
+    {
+    case cmd::stat:
+      {
+        if (i != argc - 1 || st == cmd_stat::none)
+          usage ();
+
+        string p (argv[i]);
+
+        // Note that the loading is not included in the measurement and is
+        // reported separately.
+        //
+        bench_clock::ticks load_start (bench_clock::now ());
+
+        path_list list (p);
+        const vector<string_view>& paths (list.paths ());
+
+        nanoseconds load_time (
+          bench_clock::elapsed (load_start, bench_clock::now ()));
+
+        if (paths.empty ())
+        {
+          cerr << "error: no entries in file " << p << endl;
+          throw failed ();
+        }
+
+        cerr << "load time: " << load_time << endl
+             << "load peak RSS: " << peak_rss () / 1024 << " KB" << endl;
+
+        size_t n (paths.size ());
+
+        // Partition the paths between the threads (-j only).
+        //
+        vector<vector<const string_view*>> shards (threads);
+
+        if (threads != 0)
+        {
+          switch (sh)
+          {
+          case shard::chunk:
+            {
+              size_t n (paths.size () / threads);
+              size_t r (paths.size () % threads);
+
+              for (size_t t (0), i (0); t != threads; ++t)
+              {
+                for (size_t e (i + n + (t < r ? 1 : 0)); i != e; ++i)
+                  shards[t].push_back (&paths[i]);
+              }
+
+              break;
+            }
+          case shard::round_robin:
+            {
+              for (size_t i (0); i != paths.size (); ++i)
+                shards[i % threads].push_back (&paths[i]);
+
+              break;
+            }
+          case shard::dir:
+            {
+              // Group the paths by their parent directories, preserving the
+              // order, and assign each group as a whole to the thread with
+              // the least number of paths assigned so far.
+              //
+              vector<vector<const string_view*>> groups;
+              unordered_map<string_view, size_t> group_map;
+
+              for (const string_view& p: paths)
+              {
+                size_t n (p.rfind ('/'));
+                string_view d (p.data (), n != string_view::npos ? n : 0);
+
+                auto i (group_map.emplace (d, groups.size ()));
+                if (i.second)
+                  groups.emplace_back ();
+
+                groups[i.first->second].push_back (&p);
+              }
+
+              for (vector<const string_view*>& g: groups)
+              {
+                vector<const string_view*>* s (&shards[0]);
+                for (vector<const string_view*>& v: shards)
+                {
+                  if (v.size () < s->size ())
+                    s = &v;
+                }
+
+                s->insert (s->end (), g.begin (), g.end ());
+              }
+
+              break;
+            }
+          }
+        }
+
+        vector<nanoseconds> thread_times (threads);
+
+#ifdef STAT_BENCHMARK_IO_URING
+        // Note that we set up the ring outside of the measurement.
+        //
+        optional<uring> ring;
+        size_t enter_calls (0); // In the last run.
+
+        if (st == cmd_stat::uring)
+          ring.emplace (queue_depth);
+#endif
+
+        // Stat all the paths once and return the time spent.
+        //
+        auto run = [&] () -> nanoseconds
+        {
+          if (threads != 0)
+          {
+            // Note that we make the threads wait for the common start
+            // signal so that their startup is not included in the
+            // measurement.
+            //
+            vector<thread> ts;
+            atomic<bool> start (false);
+            atomic<bool> stop (false);
+
+            std::mutex exception_mutex;
+            exception_ptr exception;
+
+            ts.reserve (threads);
+
+            thread_guard g (ts, [&start, &stop] {stop = true; start = true;});
+
+            for (size_t t (0); t != threads; ++t)
+            {
+              ts.emplace_back (
+                [t, &shards, &thread_times, &start, &stop, &entry_tm_at,
+                 &exception_mutex, &exception] ()
+                {
+                  while (!start)
+                    this_thread::yield ();
+
+                  if (stop)
+                    return;
+
+                  try
+                  {
+                    bench_clock::ticks start_time (bench_clock::now ());
+
+                    for (const string_view* p: shards[t])
+                      latency_timed (latency_local.stat,
+                                     [&entry_tm_at, p]
+                                     {
+                                       return entry_tm_at (AT_FDCWD,
+                                                           p->data ());
+                                     });
+
+                    thread_times[t] = bench_clock::elapsed (
+                      start_time, bench_clock::now ());
+
+                    latency_flush ();
+                  }
+                  catch (...)
+                  {
+                    lock_guard<std::mutex> l (exception_mutex);
+
+                    if (!exception)
+                      exception = current_exception ();
+                  }
+                });
+            }
+
+            bench_clock::ticks start_time (bench_clock::now ());
+
+            start = true;
+            g.join ();
+
+            bench_clock::ticks end_time (bench_clock::now ());
+
+            if (exception)
+              rethrow_exception (exception);
+
+            return bench_clock::elapsed (start_time, end_time);
+          }
+
+#ifdef STAT_BENCHMARK_IO_URING
+          if (st == cmd_stat::uring)
+          {
+            // Keep up to the queue depth statx requests in flight,
+            // submitting them in batches and reaping the completions as
+            // they become available, only blocking if no more requests can
+            // be queued.
+            //
+            uring& r (*ring);
+
+            struct slot
+            {
+              struct statx s;
+              size_t path;              // Index in paths.
+              bench_clock::ticks queued; // Queuing time (--histogram only).
+            };
+
+            vector<slot> slots (queue_depth);
+            vector<unsigned> free_slots;
+
+            for (unsigned i (queue_depth); i != 0; --i)
+              free_slots.push_back (i - 1);
+
+            size_t next (0);      // Next path to queue.
+            size_t done (0);      // Number of completed requests.
+            unsigned queued (0);  // Number of requests queued since submit.
+
+            size_t calls (r.enter_calls ());
+
+            bench_clock::ticks start_time (bench_clock::now ());
+
+            while (done != n)
+            {
+              for (; next != n && !free_slots.empty () && queued != batch;
+                   ++next, ++queued)
+              {
+                unsigned s (free_slots.back ());
+                free_slots.pop_back ();
+
+                io_uring_sqe* e (r.get_sqe ());
+                assert (e != nullptr); // Can't be more than the queue depth.
+
+                e->opcode = IORING_OP_STATX;
+                e->fd = AT_FDCWD;
+                e->addr = reinterpret_cast<uintptr_t> (paths[next].data ());
+                e->len = statx_mask;
+                e->statx_flags = static_cast<__u32> (statx_flags);
+                e->off = reinterpret_cast<uintptr_t> (&slots[s].s);
+                e->user_data = s;
+
+                slots[s].path = next;
+
+                if (latency_enabled)
+                  slots[s].queued = bench_clock::now ();
+              }
+
+              // Submit the queued requests and, if we cannot queue more and
+              // there are no completions yet, wait for one.
+              //
+              unsigned wait (
+                (next == n || free_slots.empty ()) && r.peek_cqe () == nullptr
+                ? 1
+                : 0);
+
+              if (queued != 0 || wait != 0)
+              {
+                r.submit (wait);
+                queued = 0;
+              }
+
+              for (io_uring_cqe* e; (e = r.peek_cqe ()) != nullptr; )
+              {
+                unsigned s (static_cast<unsigned> (e->user_data));
+                int res (e->res);
+
+                r.cqe_seen ();
+
+                // Note that for io_uring the latency is from queuing the
+                // request to reaping its completion.
+                //
+                if (latency_enabled)
+                  latency_local.stat.record (
+                    bench_clock::elapsed (slots[s].queued,
+                                          bench_clock::now ()).count ());
+
+                if (res < 0 && res != -ENOENT && res != -ENOTDIR)
+                {
+                  cerr << "error: statx() failed for " << paths[slots[s].path]
+                       << ": " << errno_msg (-res) << endl;
+
+                  throw failed ();
+                }
+
+                if (res == 0)
+                {
+                  // Retrieve the times, similar to the other methods.
+                  //
+                  const struct statx& x (slots[s].s);
+
+                  entry_time et {
+                    (x.stx_mask & STATX_MTIME) != 0
+                    ? tm (x.stx_mtime.tv_sec, x.stx_mtime.tv_nsec)
+                    : timestamp_unknown,
+                    (x.stx_mask & STATX_ATIME) != 0
+                    ? tm (x.stx_atime.tv_sec, x.stx_atime.tv_nsec)
+                    : timestamp_unknown};
+
+                  (void) et;
+                }
+
+                free_slots.push_back (s);
+                ++done;
+              }
+            }
+
+            bench_clock::ticks end_time (bench_clock::now ());
+
+            enter_calls = r.enter_calls () - calls;
+            return bench_clock::elapsed (start_time, end_time);
+          }
+#endif
+
+          bench_clock::ticks start_time (bench_clock::now ());
+
+          for (const string_view& p: paths)
+            latency_timed (latency_local.stat,
+                           [&entry_tm_at, &p]
+                           {
+                             return entry_tm_at (AT_FDCWD, p.data ());
+                           });
+
+          return bench_clock::elapsed (start_time, bench_clock::now ());
+        };
+
+        vector<nanoseconds> ds (
+          measure (run,
+                   [&paths] ()
+                   {
+                     for (const string_view& p: paths)
+                       evict_entry (AT_FDCWD, p.data ());
+                   }));
+
+        nanoseconds d (report (n, ds));
+
+        if (threads != 0)
         {
-          DWORD a (GetFileAttributesA (p.c_str ()));
-          if (a == INVALID_FILE_ATTRIBUTES)
+          // Note that the time can be zero with a coarse clock.
+          //
+          if (d.count () != 0)
+            cerr << "throughput: "
+                 << static_cast<uint64_t> (n * 1e9 / d.count ())
+                 << " entries/sec" << endl;
+
+          cerr << "threads: " << threads << endl;
+
+          for (size_t t (0); t != threads; ++t)
           {
-            cerr << "error: GetFileAttributesA() failed for " << p << ": "
-                 << last_error_msg () << endl;
+            size_t n (shards[t].size ());
 
-            throw failed ();
-          }
+            cerr << "thread " << t << " entries: " << n
+                 << " time: " << thread_times[t];
 
-          return {timestamp_nonexistent, timestamp_nonexistent};
+            if (n != 0)
+              cerr << " time per entry: " << thread_times[t] / n;
+
+            cerr << endl;
+          }
         }
-      case cmd_stat::attrs_ex:
+
+#ifdef STAT_BENCHMARK_IO_URING
+        if (st == cmd_stat::uring)
+          cerr << "io_uring_enter calls: " << enter_calls << endl;
+#endif
+
+        report_latency ();
+        report_record ("stat", stat_method (), n, ds, d, string (paths[0]));
+
+        if (print_result)
+          cout << d.count () / n << endl;
+
+        break;
+      }
+    case cmd::iter:
+    case cmd::diff:
+      {
+        if (i != argc - (c == cmd::diff ? 2 : 1) || it == cmd_iter::none)
+          usage ();
+
+        // Load the snapshot index (diff, --incremental only).
+        //
+        optional<snapshot_index> index;
+
+        // Direct sub-directories of the index directories as the (parent,
+        // child) record index pairs, sorted by parent (--incremental only).
+        //
+        vector<pair<size_t, size_t>> subdirs;
+
+        if (c == cmd::diff || !incremental.empty ())
         {
-          WIN32_FILE_ATTRIBUTE_DATA a;
-          if (!GetFileAttributesExA (p.c_str (), GetFileExInfoStandard, &a))
+          bench_clock::ticks load_start (bench_clock::now ());
+
+          index.emplace (c == cmd::diff ? argv[i++] : incremental.c_str ());
+
+          if (!incremental.empty ())
           {
-            cerr << "error: GetFileAttributesExA() failed for " << p
-                 << ": " << last_error_msg () << endl;
+            for (size_t i (0); i != index->size (); ++i)
+            {
+              const snapshot_index::record& r ((*index)[i]);
+              string_view p (index->path (r));
 
-            throw failed ();
+              if (p.empty () || !S_ISDIR (r.mode))
+                continue;
+
+              size_t n (p.rfind ('/'));
+              size_t pi (index->find (n != string_view::npos
+                                      ? p.substr (0, n)
+                                      : string_view ()));
+
+              if (pi != index->size ())
+                subdirs.emplace_back (pi, i);
+            }
+
+            sort (subdirs.begin (), subdirs.end ());
           }
 
-          return {tm (a.ftLastWriteTime), tm (a.ftLastAccessTime)};
+          cerr << "index load time: "
+               << bench_clock::elapsed (load_start, bench_clock::now ())
+               << endl
+               << "index entries: " << index->size () << endl;
         }
-      case cmd_stat::handle:
+
+        string p (argv[i]);
+
+        // Per-thread statistics (-j only).
+        //
+        vector<iter_counters> thread_stats;
+
+        // Traverse the directory tree on the worker threads, processing each
+        // directory as a separate task. The task function is called as
+        // f (d, pool, w) and is expected to push the sub-directories of d to
+        // the worker's deque rather than to recurse into them.
+        //
+        auto traverse = [threads, &thread_stats] (const string& d,
+                                                  const auto& f)
         {
-          auto_handle h (
-            CreateFile (p.c_str (),
-                        0,
-                        0,
-                        nullptr,
-                        OPEN_EXISTING,
-                        FILE_FLAG_BACKUP_SEMANTICS,// Required for a directory.
-                        nullptr));
+          work_stealing_pool<string> pool (threads);
+          thread_stats.assign (threads, iter_counters ());
 
-          if (h == nullhandle)
-          {
-            cerr << "error: CreateFile failed for " << p << ": "
-                 << last_error_msg () << endl;
+          pool.push (0, d);
+          pool.run ([&pool, &f] (size_t w, const string& d) {f (d, pool, w);},
+                    [&thread_stats] (size_t w)
+                    {
+                      thread_stats[w] = iter_stats;
+                      latency_flush ();
+                    });
+        };
+
+        // The path buffer shared across the (serial) recursion. The entry
+        // names are appended to it and then truncated in place, so that no
+        // allocations are made per entry once it has grown large enough.
+        // Note that the parallel traversal uses one such buffer per thread.
+        //
+        string path;
 
-            throw failed ();
+        // The directories yet to be traversed, in the full path form
+        // (--order bfs).
+        //
+        deque<string> bfs_queue;
+
+        // Whether to process each directory's entries in the inode order
+        // (--order inode).
+        //
+        bool inode_order (ord == order::inode);
+
+        // Write the entry path (the directory path d followed by the entry
+        // name n, unless NULL) and, if requested, its times to stdout (-P).
+        // Accumulate the time spent so that it can be reported separately.
+        //
+        fd_writer out (STDOUT_FILENO);
+        nanoseconds listing_time (0);
+
+        auto list = [print, st, null_sep, &out, &listing_time]
+                    (const string& d, const char* n, const entry_time& et)
+        {
+          bench_clock::ticks start_time (bench_clock::now ());
+
+          out.write (d);
+
+          if (n != nullptr)
+          {
+            out.put ('/');
+            out.write (n);
           }
 
-          BY_HANDLE_FILE_INFORMATION r;
-          if (!GetFileInformationByHandle (h.get (), &r))
+          if (print > 1 && st != cmd_stat::none)
           {
-            cerr << "error: GetFileInformationByHandle() failed for " << p
-                 << ": " << last_error_msg () << endl;
+            static timestamp_formatter f;
+            char b[timestamp_formatter::capacity];
 
-            throw failed ();
+            out.write (" smod ");
+            out.write (b, f.format (et.modification, b));
+            out.write (" sacc ");
+            out.write (b, f.format (et.access, b));
           }
 
-          return {tm (r.ftLastWriteTime), tm (r.ftLastAccessTime)};
-        }
-      case cmd_stat::none: break;
-      }
+          out.put (null_sep ? '\0' : '\n');
 
-      assert (false); // Can't be here.
-      return {timestamp_nonexistent, timestamp_nonexistent};
-    };
+          listing_time += bench_clock::elapsed (start_time,
+                                                bench_clock::now ());
+        };
 
-    switch (c)
-    {
-    case cmd::stat:
-      {
-        if (i != argc - 1 || st == cmd_stat::none)
-          usage ();
+        // Record the entry (the directory path d followed by the entry name
+        // n, unless NULL) in the snapshot (--snapshot) or compare it against
+        // the snapshot index (diff). In the latter case, print the added (A)
+        // and modified (M) entries to stdout (-P).
+        //
+        vector<snapshot_index::entry> snapshot_entries;
+
+        vector<bool> seen;    // Index entries seen (diff only).
+        size_t added (0);
+        size_t modified (0);
+        size_t removed (0);
+
+        auto visit = [&p,
+                      &index,
+                      &snapshot_entries,
+                      &seen,
+                      &added,
+                      &modified,
+                      print,
+                      null_sep,
+                      &out] (string& d,
+                             const char* n,
+                             const entry_time& et,
+                             const entry_info& ei)
+        {
+          size_t dn (d.size ());
 
-        string p (argv[i]);
+          if (n != nullptr)
+          {
+            d += '/';
+            d += n;
+          }
 
-        ifstream f (p);
-        if (!f.is_open ())
-        {
-          cerr << "error: can't open " << p << endl;
-          throw failed ();
-        }
+          string_view r (d);
+          r.remove_prefix (r.size () != p.size () ? p.size () + 1 : r.size ());
 
-        f.exceptions (ifstream::badbit);
+          int64_t mt (
+            duration_cast<nanoseconds> (
+              et.modification.time_since_epoch ()).count ());
 
-        vector<string> paths;
-        for (string p; getline (f, p); )
-          paths.push_back (move (p));
+          if (!index)
+            snapshot_entries.push_back (
+              snapshot_index::entry {
+                string (r), ei.ino, ei.size, mt, ei.mode});
+          else
+          {
+            size_t i (index->find (r));
+            char c ('\0');
 
-        if (!f.eof ())
-        {
-          cerr << "error: can't read " << p << endl;
-          throw failed ();
-        }
+            if (i == index->size ())
+            {
+              ++added;
+              c = 'A';
+            }
+            else
+            {
+              const snapshot_index::record& e ((*index)[i]);
 
-        if (paths.empty ())
+              seen[i] = true;
+
+              if (e.ino != ei.ino || e.size != ei.size || e.mtime != mt)
+              {
+                ++modified;
+                c = 'M';
+              }
+            }
+
+            if (c != '\0' && print != 0)
+            {
+              out.put (c);
+              out.put (' ');
+              out.write (d);
+              out.put (null_sep ? '\0' : '\n');
+            }
+          }
+
+          d.resize (dn);
+        };
+
+        // Pipeline statistics (--pipeline only). Note that they are for the
+        // last run.
+        //
+        struct pipeline_counters
         {
-          cerr << "error: no entries in file " << p << endl;
-          throw failed ();
-        }
+          size_t stalls = 0; // Times had to wait for the queue.
+          nanoseconds stall_time {0};
+          size_t entries = 0;
+        };
 
-        timestamp start_time (system_clock::now ());
+        pipeline_counters producer_stats;
+        vector<pipeline_counters> worker_stats;
 
-        for (const string& p: paths)
-          entry_tm (p);
+        // Note that the queue is reused between the runs, so that its cell
+        // buffers only grow during the first one.
+        //
+        optional<mpmc_queue<string>> pipeline_queue;
 
-        timestamp end_time (system_clock::now ());
+        if (pipeline != 0)
+          pipeline_queue.emplace (1024);
 
-        nanoseconds d (end_time - start_time);
+        // Traverse the directory once and return the time spent.
+        //
+        auto run = [&] () -> nanoseconds
+        {
+          iter_stats = iter_counters ();
+          listing_time = nanoseconds (0);
 
-        cerr << "entries: " << paths.size () << endl
-             << "full time: " << d << endl
-             << "time per entry: " << d / paths.size () << endl;
+          snapshot_entries.clear ();
+          added = modified = removed = 0;
 
-        if (print_result)
-          cout << d.count () / paths.size () << endl;
+          if (c == cmd::diff)
+            seen.assign (index->size (), false);
 
-        break;
-      }
-    case cmd::iter:
-      {
-        if (i != argc - 1 || it == cmd_iter::none)
-          usage ();
+          bench_clock::ticks start_time (bench_clock::now ());
 
-        string p (argv[i]);
+          // Note that the traversed directory itself is also recorded.
+          //
+          if (track)
+          {
+            path = p;
 
-        size_t count (0);
-        timestamp start_time (system_clock::now ());
+            entry_info ei;
+            entry_time et (entry_tm_at (AT_FDCWD, p.c_str (), &ei));
+            visit (path, nullptr, et, ei);
+          }
 
-        switch (it)
-        {
-        case cmd_iter::posix:
+          switch (it)
           {
-            auto iterate = [&count] (const string& d,
-                                     const auto& iterate) -> void
+          case cmd_iter::opendir:
             {
-              struct auto_dir
+              // Traverse the directory on this thread, pushing the entry
+              // paths into the bounded queue, and stat them on the worker
+              // threads (--pipeline).
+              //
+              // Note that the paths are copied into (and out of) the queue
+              // cells whose string buffers are reused, so that no allocations
+              // are made per entry. Also note that the time includes the
+              // workers startup.
+              //
+              if (pipeline != 0)
               {
-                explicit
-                auto_dir (intptr_t& h): h_ (&h) {}
+                mpmc_queue<string>& queue (*pipeline_queue);
+
+                atomic<bool> done (false);
+                atomic<bool> stop (false);
+
+                std::mutex exception_mutex;
+                exception_ptr exception;
+
+                producer_stats = pipeline_counters ();
+                worker_stats.assign (pipeline, pipeline_counters ());
+
+                vector<thread> ws;
+                ws.reserve (pipeline);
 
-                auto_dir (const auto_dir&) = delete;
-                auto_dir& operator= (const auto_dir&) = delete;
+                thread_guard wg (ws, [&stop] {stop = true;});
 
-                ~auto_dir ()
+                for (size_t w (0); w != pipeline; ++w)
                 {
-                  if (h_ != nullptr && *h_ != -1)
-                    _findclose (*h_);
+                  ws.emplace_back (
+                    [w, &queue, &done, &stop, &worker_stats, &entry_tm_at,
+                     &exception_mutex, &exception] ()
+                    {
+                      pipeline_counters& s (worker_stats[w]);
+
+                      try
+                      {
+                        string p;
+
+                        auto pop = [&queue, &p] ()
+                        {
+                          return queue.try_pop ([&p] (string& v) {p = v;});
+                        };
+
+                        for (;;)
+                        {
+                          if (!pop ())
+                          {
+                            // Wait for the queue to become non-empty or for
+                            // the traversal to complete. Note that the done
+                            // flag is read before trying the queue, so that
+                            // the entries pushed before it is set are not
+                            // lost.
+                            //
+                            bench_clock::ticks st (bench_clock::now ());
+
+                            bool r;
+                            for (;;)
+                            {
+                              bool d (done || stop);
+
+                              if ((r = pop ()) || d)
+                                break;
+
+                              this_thread::yield ();
+                            }
+
+                            ++s.stalls;
+                            s.stall_time += bench_clock::elapsed (
+                              st, bench_clock::now ());
+
+                            if (!r)
+                              break;
+                          }
+
+                          latency_timed (
+                            latency_local.stat,
+                            [&entry_tm_at, &p]
+                            {
+                              return entry_tm_at (AT_FDCWD, p.c_str ());
+                            });
+
+                          ++s.entries;
+                        }
+                      }
+                      catch (...)
+                      {
+                        lock_guard<std::mutex> l (exception_mutex);
+
+                        if (!exception)
+                          exception = current_exception ();
+
+                        stop = true;
+                      }
+
+                      latency_flush ();
+                    });
                 }
 
-                void release () {h_ = nullptr;}
+                auto push = [&queue, &stop, &producer_stats] (const string& p)
+                {
+                  auto set = [&p] (string& v) {v = p;};
+
+                  if (queue.try_push (set))
+                    return;
 
-              private:
-                intptr_t* h_;
+                  // Wait for the queue to become non-full.
+                  //
+                  ++producer_stats.stalls;
+                  bench_clock::ticks st (bench_clock::now ());
+
+                  while (!queue.try_push (set))
+                  {
+                    if (stop)
+                      throw failed (); // Diagnostics issued by the worker.
+
+                    this_thread::yield ();
+                  }
+
+                  producer_stats.stall_time += bench_clock::elapsed (
+                    st, bench_clock::now ());
+                };
+
+                auto iterate = [&push] (string& d, const auto& iterate) -> void
+                {
+                  read_dir (d,
+                            [&push, &d, &iterate] (const dirent& de)
+                            {
+                              ++iter_stats.entries;
+
+                              size_t dn (d.size ());
+                              d += '/';
+                              d += de.d_name;
+
+                              push (d);
+
+                              if (de.d_type == DT_DIR)
+                                iterate (d, iterate);
+
+                              d.resize (dn);
+                            });
+                };
+
+                // Note that if the traversal fails, then we prefer the
+                // worker's exception, if any, since the producer may have
+                // failed because of it (see push() above).
+                //
+                try
+                {
+                  path = p;
+                  iterate (path, iterate);
+                }
+                catch (...)
+                {
+                  stop = true;
+                  wg.join ();
+
+                  if (exception)
+                    rethrow_exception (exception);
+
+                  throw;
+                }
+
+                done = true;
+                wg.join ();
+
+                if (exception)
+                  rethrow_exception (exception);
+
+                producer_stats.entries = iter_stats.entries;
+                break;
+              }
+
+              // Pre-visit hook that returns the snapshot index record of the
+              // directory d if it should be pruned, that is, not read and its
+              // entries not stated (--incremental). The directory's entry
+              // information is passed in ei and et.
+              //
+              // If the directory's own inode and modification time match its
+              // snapshot index record, then its entries could not have been
+              // added, removed, or renamed and so it is pruned. We still,
+              // however, stat its sub-directories (known from the index) and
+              // recurse into them since their own entries could have changed
+              // (see below).
+              //
+              auto prune = [&incremental, &index, &p] (const string& d,
+                                                       const entry_time& et,
+                                                       const entry_info& ei)
+                -> optional<size_t>
+              {
+                if (incremental.empty ())
+                  return nullopt;
+
+                // Note that the traversed directory itself has an empty path.
+                //
+                size_t ri (
+                  index->find (d.size () != p.size ()
+                               ? string_view (d).substr (p.size () + 1)
+                               : string_view ()));
+
+                if (ri == index->size ())
+                  return nullopt;
+
+                const snapshot_index::record& r ((*index)[ri]);
+
+                if (r.ino != ei.ino ||
+                    r.mtime != duration_cast<nanoseconds> (
+                      et.modification.time_since_epoch ()).count ())
+                  return nullopt;
+
+                return ri;
+              };
+
+              // Note that the directory path d is used as the path buffer for
+              // the sub-entries (see below). If pr is present, then the
+              // directory is pruned with pr being its index record (see
+              // above).
+              //
+              // Note that the entry information is also required to decide
+              // whether to prune the sub-directories (--incremental).
+              //
+              bool info (track || !incremental.empty ());
+
+              auto iterate = [st,
+                              &entry_tm_at,
+                              print,
+                              &list,
+                              track,
+                              &visit,
+                              inode_order,
+                              &prune,
+                              info,
+                              &index,
+                              &subdirs]
+                             (string& d,
+                              optional<size_t> pr,
+                              const auto& iterate) -> void
+              {
+                // Process the entry with name n and type t.
+                //
+                auto entry = [st, &entry_tm_at, print, &list, track, &visit,
+                              &prune, info, &d, &iterate] (string_view n,
+                                                          unsigned char t)
+                {
+                  ++iter_stats.entries;
+
+                  // Append the entry name to the directory path in place and
+                  // truncate it back when done.
+                  //
+                  size_t dn (d.size ());
+                  d += '/';
+                  d += n;
+
+                  entry_time et;
+                  entry_info ei;
+                  if (st != cmd_stat::none)
+                    et = latency_timed (
+                      latency_local.stat,
+                      [&entry_tm_at, &d, &ei, info]
+                      {
+                        return entry_tm_at (AT_FDCWD,
+                                            d.c_str (),
+                                            info ? &ei : nullptr);
+                      });
+
+                  if (track)
+                    visit (d, nullptr, et, ei);
+                  else if (print != 0)
+                    list (d, nullptr, et);
+
+                  if (t == DT_DIR)
+                    iterate (d, prune (d, et, ei), iterate);
+
+                  d.resize (dn);
+                };
+
+                if (pr)
+                {
+                  ++iter_stats.pruned;
+
+                  auto i (lower_bound (subdirs.begin (),
+                                       subdirs.end (),
+                                       make_pair (*pr, size_t (0))));
+
+                  // Note that the sub-directory can't disappear unless the
+                  // directory is modified.
+                  //
+                  for (; i != subdirs.end () && i->first == *pr; ++i)
+                  {
+                    string_view s (index->path ((*index)[i->second]));
+                    size_t n (s.rfind ('/'));
+
+                    if (n != string_view::npos)
+                      s.remove_prefix (n + 1);
+
+                    entry (s, DT_DIR);
+                  }
+
+                  return;
+                }
+
+                ++iter_stats.dirs;
+
+                dir_entries es;
+
+                read_dir (d,
+                          [inode_order, &es, &entry] (const dirent& de)
+                          {
+                            if (inode_order)
+                              es.add (de.d_ino, de.d_type, de.d_name);
+                            else
+                              entry (de.d_name, de.d_type);
+                          });
+
+                // Note that the directory is already closed at this point.
+                //
+                if (inode_order)
+                {
+                  es.sort_by_inode ();
+
+                  for (const dir_entries::entry& e: es.entries ())
+                    entry (es.name (e), e.type);
+                }
               };
 
-              intptr_t h (-1);
-              auto_dir ad (h);
+              if (threads == 0 && ord == order::bfs)
+              {
+                bfs_queue.push_back (p);
+
+                for (; !bfs_queue.empty (); bfs_queue.pop_front ())
+                {
+                  path = bfs_queue.front ();
+                  iterate (path,
+                           nullopt,
+                           [&bfs_queue] (const string& p,
+                                         optional<size_t>,
+                                         const auto&)
+                           {
+                             bfs_queue.push_back (p);
+                           });
+                }
+              }
+              else if (threads == 0)
+              {
+                // Note that the traversed directory itself can also be
+                // pruned (--incremental).
+                //
+                optional<size_t> pr;
+
+                if (!incremental.empty ())
+                {
+                  entry_info ei;
+                  entry_time et (entry_tm_at (AT_FDCWD, p.c_str (), &ei));
+                  pr = prune (p, et, ei);
+                }
 
-              for (;;)
+                path = p;
+                iterate (path, pr, iterate);
+              }
+              else
+                traverse (p,
+                          [&iterate] (const string& d,
+                                      work_stealing_pool<string>& pool,
+                                      size_t w)
+                          {
+                            static thread_local string path;
+
+                            path = d;
+                            iterate (path,
+                                     nullopt,
+                                     [&pool, w] (const string& p,
+                                                 optional<size_t>,
+                                                 const auto&)
+                                     {
+                                       pool.push (w, p);
+                                     });
+                          });
+
+              break;
+            }
+          case cmd_iter::openat:
+            {
+              // Iterate over the directory n, which is relative to the parent
+              // directory file descriptor pfd, stating the entries and opening
+              // the sub-directories relative to the directory file descriptor.
+              // This way the kernel doesn't need to resolve the full path for
+              // every entry. Note that the directory path d is only used for
+              // diagnostics and printing.
+              //
+              // Also note that when traversing in parallel, the sub-directories
+              // are opened via their full paths (one path resolution per
+              // directory rather than per entry).
+              //
+              auto iterate = [st,
+                              &entry_tm_at,
+                              print,
+                              &list,
+                              track,
+                              &visit,
+                              inode_order]
+                             (int pfd,
+                              const char* n,
+                              string& d,
+                              const auto& iterate) -> void
               {
-                bool r;
-                _finddata_t fi;
+                struct dir_deleter
+                {
+                  void operator() (DIR* p) const
+                  {
+                    if (p != nullptr)
+                      closedir (p);
+                  }
+                };
+
+                int fd (openat (pfd, n, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+
+                if (fd == -1)
+                {
+                  cerr << "error: openat() failed for " << d << ": "
+                       << last_errno_msg () << endl;
+                  throw failed ();
+                }
+
+                unique_ptr<DIR, dir_deleter> h (fdopendir (fd));
+
+                if (h == nullptr)
+                {
+                  int e (errno);
+                  close (fd);
+
+                  cerr << "error: fdopendir() failed for " << d << ": "
+                       << errno_msg (e) << endl;
+                  throw failed ();
+                }
+
+                int dfd (dirfd (h.get ()));
 
-                if (h == -1)
+                // Process the entry with name n and type t.
+                //
+                auto entry = [st, &entry_tm_at, print, &list, track, &visit,
+                              dfd, &d, &iterate] (const char* n,
+                                                  unsigned char t)
+                {
+                  ++iter_stats.entries;
+
+                  entry_time et;
+                  entry_info ei;
+                  if (st != cmd_stat::none)
+                    et = latency_timed (
+                      latency_local.stat,
+                      [&entry_tm_at, dfd, n, &ei, track]
+                      {
+                        return entry_tm_at (dfd, n, track ? &ei : nullptr);
+                      });
+
+                  if (track)
+                    visit (d, n, et, ei);
+                  else if (print != 0)
+                    list (d, n, et);
+
+                  if (t == DT_DIR)
+                  {
+                    size_t dn (d.size ());
+                    d += '/';
+                    d += n;
+
+                    iterate (dfd, n, d, iterate);
+
+                    d.resize (dn);
+                  }
+                };
+
+                dir_entries es;
+
+                if (!read_dir (h.get (),
+                               &latency_local.read,
+                               [inode_order, &es, &entry] (const dirent& de)
+                               {
+                                 if (inode_order)
+                                   es.add (de.d_ino, de.d_type, de.d_name);
+                                 else
+                                   entry (de.d_name, de.d_type);
+                               }))
                 {
-                  h = _findfirst ((d + "\\*").c_str (), &fi);
-                  r = (h != -1);
+                  cerr << "error: readdir() failed for " << d << ": "
+                       << last_errno_msg () << endl;
+                  throw failed ();
                 }
-                else
-                  r = (_findnext (h, &fi) == 0);
 
-                if (r)
+                if (inode_order)
                 {
-                  string p (fi.name);
-
-                  if (p == "." || p == "..")
-                    continue;
+                  es.sort_by_inode ();
 
-                  ++count;
-
-                  if ((fi.attrib & _A_SUBDIR) != 0)
-                    iterate (d + '\\' + p, iterate);
+                  for (const dir_entries::entry& e: es.entries ())
+                    entry (es.name (e), e.type);
                 }
-                else if (errno == ENOENT)
-                {
-                  // End of stream.
-                  //
-                  if (h != -1)
-                  {
-                    _findclose (h);
-                    h = -1;
-                  }
+              };
 
-                  break;
-                }
-                else
+              if (threads == 0 && ord == order::bfs)
+              {
+                bfs_queue.push_back (p);
+
+                for (; !bfs_queue.empty (); bfs_queue.pop_front ())
                 {
-                  cerr << "error: _find*() failed: " << last_errno_msg ()
-                       << endl;
-                  throw failed ();
+                  path = bfs_queue.front ();
+                  iterate (AT_FDCWD,
+                           bfs_queue.front ().c_str (),
+                           path,
+                           [&bfs_queue] (int,
+                                         const char*,
+                                         const string& p,
+                                         const auto&)
+                           {
+                             bfs_queue.push_back (p);
+                           });
                 }
               }
-            };
-
-            iterate (p, iterate);
-
-            break;
-          }
-
-        case cmd_iter::native:
-        case cmd_iter::native_ex:
-          {
-            auto iterate = [&count, st, it, &tm, &entry_tm, print]
-                           (const string& d, const auto& iterate) -> void
+              else if (threads == 0)
+              {
+                path = p;
+                iterate (AT_FDCWD, p.c_str (), path, iterate);
+              }
+              else
+                traverse (p,
+                          [&iterate] (const string& d,
+                                      work_stealing_pool<string>& pool,
+                                      size_t w)
+                          {
+                            static thread_local string path;
+
+                            path = d;
+                            iterate (AT_FDCWD,
+                                     d.c_str (),
+                                     path,
+                                     [&pool, w] (int,
+                                                 const char*,
+                                                 const string& p,
+                                                 const auto&)
+                                     {
+                                       pool.push (w, p);
+                                     });
+                          });
+
+              break;
+            }
+          case cmd_iter::getdents:
             {
-              struct auto_dir
+#ifdef __linux__
+              // Note that the entries are read straight into the user buffer
+              // via the getdents64() syscall, bypassing readdir() and its
+              // internal buffering. The rest is similar to openat (see above).
+              //
+              struct linux_dirent64
+              {
+                uint64_t       d_ino;
+                int64_t        d_off;
+                unsigned short d_reclen;
+                unsigned char  d_type;
+                char           d_name[];
+              };
+
+              struct auto_fd
               {
                 explicit
-                auto_dir (HANDLE& h): h_ (&h) {}
+                auto_fd (int fd): fd_ (fd) {}
 
-                auto_dir (const auto_dir&) = delete;
-                auto_dir& operator= (const auto_dir&) = delete;
+                auto_fd (const auto_fd&) = delete;
+                auto_fd& operator= (const auto_fd&) = delete;
 
-                ~auto_dir ()
-                {
-                  if (h_ != nullptr && *h_ != INVALID_HANDLE_VALUE)
-                    FindClose (*h_);
-                }
+                ~auto_fd () {if (fd_ != -1) close (fd_);}
 
-                void release () {h_ = nullptr;}
+                int get () const {return fd_;}
 
               private:
-                HANDLE* h_;
+                int fd_;
               };
 
-              HANDLE h (INVALID_HANDLE_VALUE);
-              auto_dir ad (h);
-
-              for (;;)
+              auto iterate = [dirent_buf,
+                              st,
+                              &entry_tm_at,
+                              print,
+                              &list,
+                              track,
+                              &visit,
+                              inode_order]
+                             (int pfd,
+                              const char* n,
+                              string& d,
+                              size_t depth,
+                              const auto& iterate) -> void
               {
-                bool r;
-                WIN32_FIND_DATA fi;
-
-                if (h == INVALID_HANDLE_VALUE)
+                // Buffers per recursion depth, so that we don't allocate one
+                // per directory. Note that they are per thread (see iter -j).
+                //
+                // Note that the entry buffers (--order inode) are in deque
+                // so that references to them stay valid as the recursion
+                // adds deeper ones.
+                //
+                static thread_local vector<unique_ptr<char[]>> bufs;
+                static thread_local deque<dir_entries> ebufs;
+
+                int fd (openat (pfd, n, O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+
+                if (fd == -1)
                 {
-                  string p (d + "\\*");
-
-                  if (it == cmd_iter::native)
-                    h = FindFirstFileA (p.c_str (), &fi);
-                  else
-                    h = FindFirstFileExA (p.c_str (),
-                                          FindExInfoBasic,
-                                          &fi,
-                                          FindExSearchNameMatch,
-                                          NULL,
-                                          0);
-
-                  r = (h != INVALID_HANDLE_VALUE);
+                  cerr << "error: openat() failed for " << d << ": "
+                       << last_errno_msg () << endl;
+                  throw failed ();
                 }
-                else
-                  r = FindNextFileA (h, &fi);
 
-                DWORD e (GetLastError ());
+                auto_fd h (fd);
 
-                if (r)
-                {
-                  string p (fi.cFileName);
+                if (depth == bufs.size ())
+                  bufs.emplace_back (new char[dirent_buf]);
 
-                  if (p == "." || p == "..")
-                    continue;
+                char* buf (bufs[depth].get ());
 
-                  ++count;
+                if (inode_order)
+                {
+                  if (depth == ebufs.size ())
+                    ebufs.emplace_back ();
 
-                  p = d + '\\' + p;
+                  ebufs[depth].clear ();
+                }
 
-                  bool dir (
-                    (fi.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+                ++iter_stats.dirs;
 
-                  entry_time t {
-                    tm (fi.ftLastWriteTime), tm (fi.ftLastAccessTime)};
+                // Process the entry with name n and type t.
+                //
+                auto entry = [st, &entry_tm_at, print, &list, track, &visit,
+                              fd, &d, depth, &iterate] (const char* n,
+                                                        unsigned char t)
+                {
+                  ++iter_stats.entries;
 
                   entry_time et;
-
+                  entry_info ei;
                   if (st != cmd_stat::none)
+                    et = latency_timed (
+                      latency_local.stat,
+                      [&entry_tm_at, fd, n, &ei, track]
+                      {
+                        return entry_tm_at (fd, n, track ? &ei : nullptr);
+                      });
+
+                  if (track)
+                    visit (d, n, et, ei);
+                  else if (print != 0)
+                    list (d, n, et);
+
+                  if (t == DT_DIR)
                   {
-                    et = entry_tm (p);
-
-                    // Note: as per documentation:
-                    //
-                    // The NTFS file system delays updates to the last access
-                    // time for a file by up to 1 hour after the last access
-                    //
-                    if (!(t.modification == et.modification &&
-                          t.access <= et.access))
-                    {
-                      cerr << "error: times mismatch for " << p
-                           << (dir ? "\\" : "") << endl
-                           << "  find: mod " << t.modification
-                           << " acc " << t.access << endl
-                           << "  stat: mod " << et.modification
-                           << " acc " << et.access << endl;
-                      throw failed ();
-                    }
-                  }
-
-                  if (print != 0)
-                  {
-                    cout << p;
-
-                    if (print > 1)
-                    {
-                      cout << ' ' << (dir ? "dir" : "reg") << " mod "
-                           << t.modification << " acc " << t.access;
+                    size_t dn (d.size ());
+                    d += '/';
+                    d += n;
 
-                      if (st != cmd_stat::none)
-                        cout << " smod " << et.modification << " sacc "
-                             << et.access;
-                    }
+                    iterate (fd, n, d, depth + 1, iterate);
 
-                    cout << endl;
+                    d.resize (dn);
                   }
+                };
 
-                  if (dir)
-                    iterate (p, iterate);
-                }
-                else if (e == ERROR_FILE_NOT_FOUND || e == ERROR_NO_MORE_FILES)
+                for (;;)
                 {
-                  // End of stream.
-                  //
-                  if (h != INVALID_HANDLE_VALUE)
+                  long n (
+                    latency_timed (latency_local.read,
+                                   [fd, buf, dirent_buf]
+                                   {
+                                     return syscall (SYS_getdents64,
+                                                     fd,
+                                                     buf,
+                                                     dirent_buf);
+                                   }));
+
+                  ++iter_stats.reads;
+
+                  if (n == -1)
                   {
-                    FindClose (h);
-                    h = INVALID_HANDLE_VALUE;
+                    cerr << "error: getdents64() failed for " << d << ": "
+                         << last_errno_msg () << endl;
+                    throw failed ();
                   }
 
-                  break;
-                }
-                else
-                {
-                  cerr << "error: Find*FileA() failed: " << error_msg (e)
-                       << endl;
-                  throw failed ();
-                }
-              }
-            };
-
-            iterate (p, iterate);
-
-            break;
-          }
-        case cmd_iter::none: break;
-        }
-
-        timestamp end_time (system_clock::now ());
-
-        if (count == 0)
-        {
-          cerr << "error: no entries in " << p << endl;
-          throw failed ();
-        }
-
-        nanoseconds d (end_time - start_time);
-
-        cerr << "entries: " << count << endl
-             << "full time: " << d << endl
-             << "time per entry: " << d / count << endl;
-
-        if (print_result)
-          cout << d.count () / count << endl;
-
-        break;
-      }
-    case cmd::avg:
-    case cmd::none: assert (false); break; // Can't be here.
-    }
+                  if (n == 0) // End of stream.
+                    break;
 
-#else
+                  for (long i (0); i != n; )
+                  {
+                    const linux_dirent64* de (
+                      reinterpret_cast<const linux_dirent64*> (buf + i));
 
-    enum class cmd_stat
-    {
-      none,
-      stat
-    } st (cmd_stat::none);
+                    i += de->d_reclen;
 
-    enum class cmd_iter
-    {
-      none,
-      opendir
-    } it (cmd_iter::none);
+                    const char* n (de->d_name);
+                    if (n[0] == '.' &&
+                        (n[1] == '\0' || (n[1] == '.' && n[2] == '\0')))
+                      continue;
 
-    unsigned long print (0);
-    bool print_result (false);
+                    // Note that the entries must be copied since the buffer
+                    // is reused for the next getdents64() call.
+                    //
+                    if (inode_order)
+                      ebufs[depth].add (de->d_ino, de->d_type, n);
+                    else
+                      entry (n, de->d_type);
+                  }
+                }
 
-    for (; i != argc; ++i)
-    {
-      string v (argv[i]);
+                if (inode_order)
+                {
+                  dir_entries& es (ebufs[depth]);
+                  es.sort_by_inode ();
 
-      auto sst = [&st, &usage] (cmd_stat v)
-      {
-        if (st != cmd_stat::none)
-          usage ();
+                  for (const dir_entries::entry& e: es.entries ())
+                    entry (es.name (e), e.type);
+                }
+              };
 
-        st = v;
-      };
+              if (threads == 0 && ord == order::bfs)
+              {
+                bfs_queue.push_back (p);
 
-      auto sit = [&it, &usage] (cmd_iter v)
-      {
-        if (it != cmd_iter::none)
-          usage ();
+                for (; !bfs_queue.empty (); bfs_queue.pop_front ())
+                {
+                  path = bfs_queue.front ();
+                  iterate (AT_FDCWD,
+                           bfs_queue.front ().c_str (),
+                           path,
+                           0,
+                           [&bfs_queue] (int,
+                                         const char*,
+                                         const string& p,
+                                         size_t,
+                                         const auto&)
+                           {
+                             bfs_queue.push_back (p);
+                           });
+                }
+              }
+              else if (threads == 0)
+              {
+                path = p;
+                iterate (AT_FDCWD, p.c_str (), path, 0, iterate);
+              }
+              else
+                traverse (p,
+                          [&iterate] (const string& d,
+                                      work_stealing_pool<string>& pool,
+                                      size_t w)
+                          {
+                            static thread_local string path;
+
+                            path = d;
+                            iterate (AT_FDCWD,
+                                     d.c_str (),
+                                     path,
+                                     0,
+                                     [&pool, w] (int,
+                                                 const char*,
+                                                 const string& p,
+                                                 size_t,
+                                                 const auto&)
+                                     {
+                                       pool.push (w, p);
+                                     });
+                          });
+#endif
+              break;
+            }
+          case cmd_iter::none: break;
+          }
 
-        it = v;
-      };
+          // Report the index entries that haven't been seen as removed.
+          //
+          if (c == cmd::diff)
+          {
+            for (size_t i (0); i != seen.size (); ++i)
+            {
+              if (!seen[i])
+              {
+                ++removed;
 
-      if (v == "-s")
-        sst (cmd_stat::stat);
-      else if (v == "-o")
-        sit (cmd_iter::opendir);
-      else if (v == "-P")
-      {
-        if (++i == argc)
-          usage ();
+                if (print != 0)
+                {
+                  string_view r (index->path ((*index)[i]));
 
-        print = stoul (argv[i]);
-      }
-      else if (v == "-r")
-        print_result = true;
-      else
-        break;
-    }
+                  out.write ("D ");
+                  out.write (p);
 
-    auto entry_tm = [&st] (const string& p) -> entry_time
-    {
-      switch (st)
-      {
-      case cmd_stat::stat:
-        {
-          struct stat s;
-          if (stat (p.c_str (), &s) != 0)
-          {
-            if (errno == ENOENT || errno == ENOTDIR)
-            {
-              return {timestamp_nonexistent, timestamp_nonexistent};
-            }
-            else
-            {
-              cerr << "error: stat() failed for " << p
-                   << ": " << last_errno_msg () << endl;
+                  if (!r.empty ())
+                  {
+                    out.put ('/');
+                    out.write (r);
+                  }
 
-              throw failed ();
+                  out.put (null_sep ? '\0' : '\n');
+                }
+              }
             }
           }
 
-          auto tm = [] (time_t sec, auto nsec) -> timestamp
+          if (print != 0)
           {
-            return system_clock::from_time_t (sec) +
-                   chrono::duration_cast<duration> (
-                     chrono::nanoseconds (nsec));
-          };
-
-          return {tm (s.st_mtime, mnsec<struct stat> (&s, true)),
-                  tm (s.st_atime, ansec<struct stat> (&s, true))};
-        }
-      case cmd_stat::none: break;
-      }
+            bench_clock::ticks flush_time (bench_clock::now ());
+            out.flush ();
+            listing_time += bench_clock::elapsed (flush_time,
+                                                  bench_clock::now ());
+          }
 
-      assert (false); // Can't be here.
-      return {timestamp_nonexistent, timestamp_nonexistent};
-    };
+          return bench_clock::elapsed (start_time, bench_clock::now ());
+        };
 
-    switch (c)
-    {
-    case cmd::stat:
-      {
-        if (i != argc - 1 || st == cmd_stat::none)
-          usage ();
+        vector<nanoseconds> ds (
+          measure (run, [&p] () {evict_tree (AT_FDCWD, p.c_str ());}));
 
-        string p (argv[i]);
+        iter_counters stats (iter_stats);
 
-        ifstream f (p);
-        if (!f.is_open ())
+        for (const iter_counters& s: thread_stats)
         {
-          cerr << "error: can't open " << p << endl;
-          throw failed ();
+          stats.entries += s.entries;
+          stats.dirs += s.dirs;
+          stats.reads += s.reads;
+          stats.pruned += s.pruned;
         }
 
-        f.exceptions (ifstream::badbit);
-
-        vector<string> paths;
-        for (string p; getline (f, p); )
-          paths.push_back (move (p));
+        size_t count (stats.entries);
 
-        if (!f.eof ())
+        if (count == 0)
         {
-          cerr << "error: can't read " << p << endl;
+          cerr << "error: no entries in " << p << endl;
           throw failed ();
         }
 
-        if (paths.empty ())
+        // Note that for --incremental we report the time per entry in the
+        // snapshot (excluding the directory itself) rather than per entry
+        // actually stated, so that it is comparable with the full rescan
+        // (but see below).
+        //
+        if (!incremental.empty ())
+          count = index->size () > 1 ? index->size () - 1 : 1;
+
+        nanoseconds d (report (count, ds));
+
+        if (pipeline != 0)
         {
-          cerr << "error: no entries in file " << p << endl;
-          throw failed ();
-        }
+          // Note that the time can be zero with a coarse clock.
+          //
+          if (d.count () != 0)
+            cerr << "throughput: "
+                 << static_cast<uint64_t> (count * 1e9 / d.count ())
+                 << " entries/sec" << endl;
+
+          cerr << "pipeline workers: " << pipeline << endl
+               << "producer stalls (queue full): " << producer_stats.stalls
+               << " time: " << producer_stats.stall_time << endl;
+
+          for (size_t w (0); w != worker_stats.size (); ++w)
+          {
+            const pipeline_counters& s (worker_stats[w]);
 
-        timestamp start_time (system_clock::now ());
+            cerr << "worker " << w << " entries: " << s.entries
+                 << " stalls (queue empty): " << s.stalls
+                 << " time: " << s.stall_time << endl;
+          }
+        }
 
-        for (const string& p: paths)
-          entry_tm (p);
+        if (!incremental.empty ())
+          cerr << "directories read: " << stats.dirs << endl
+               << "directories pruned: " << stats.pruned << endl
+               << "time per snapshot entry (" << count << " entries): "
+               << d / count << endl
+               << "time per entry stated (" << stats.entries << " entries): "
+               << d / stats.entries << endl;
+
+        if (print != 0)
+          cerr << "listing time: " << listing_time << endl
+               << "listing time per entry: " << listing_time / count << endl
+               << "traversal time: " << d - listing_time << endl
+               << "traversal time per entry: " << (d - listing_time) / count
+               << endl;
 
-        timestamp end_time (system_clock::now ());
+        if (it == cmd_iter::getdents)
+          cerr << "directories: " << stats.dirs << endl
+               << "getdents64 calls: " << stats.reads << endl
+               << "getdents64 calls per directory: "
+               << fixed << setprecision (2)
+               << static_cast<double> (stats.reads) / stats.dirs << endl;
 
-        nanoseconds d (end_time - start_time);
+        // Note that sorting and writing the snapshot is not included in the
+        // measurement.
+        //
+        if (!snapshot.empty ())
+        {
+          bench_clock::ticks write_start (bench_clock::now ());
 
-        cerr << "entries: " << paths.size () << endl
-             << "full time: " << d << endl
-             << "time per entry: " << d / paths.size () << endl;
+          snapshot_index::write (snapshot, snapshot_entries);
 
-        if (print_result)
-          cout << d.count () / paths.size () << endl;
+          cerr << "snapshot entries: " << snapshot_entries.size () << endl
+               << "snapshot write time: "
+               << bench_clock::elapsed (write_start, bench_clock::now ())
+               << endl;
+        }
 
-        break;
-      }
-    case cmd::iter:
-      {
-        if (i != argc - 1 || it == cmd_iter::none)
-          usage ();
+        if (c == cmd::diff)
+          cerr << "added: " << added << endl
+               << "removed: " << removed << endl
+               << "modified: " << modified << endl;
 
-        string p (argv[i]);
+        if (threads != 0)
+        {
+          cerr << "threads: " << threads << endl;
 
-        size_t count (0);
-        timestamp start_time (system_clock::now ());
+          for (size_t i (0); i != thread_stats.size (); ++i)
+            cerr << "thread " << i << " entries: " << thread_stats[i].entries
+                 << endl;
+        }
 
-        switch (it)
+        report_latency ();
+        report_record (c == cmd::diff ? "diff" : "iter",
+                       st != cmd_stat::none
+                       ? iter_method () + '+' + stat_method ()
+                       : iter_method (),
+                       count,
+                       ds,
+                       d,
+                       p);
+
+        // Compare the diff time with the time of re-stating all the index
+        // entries by path (without traversing), measured the same way (the
+        // warm-up and repetitions as well as the cache eviction). Note that
+        // this is done after reporting the diff measurement since it resets
+        // the collected counters and latencies.
+        //
+        if (c == cmd::diff)
         {
-        case cmd_iter::opendir:
+          auto restat = [&index, &entry_tm_at, &p, &path] () -> nanoseconds
           {
-            auto iterate = [&count, st, &entry_tm, print]
-                           (const string& d, const auto& iterate) -> void
+            bench_clock::ticks start_time (bench_clock::now ());
+
+            for (size_t i (0); i != index->size (); ++i)
             {
-              struct dir_deleter
-              {
-                void operator() (DIR* p) const {if (p != nullptr) closedir (p);}
-              };
+              string_view n (index->path ((*index)[i]));
 
-              unique_ptr<DIR, dir_deleter> h (opendir (d.c_str ()));
+              path = p;
 
-              if (h == nullptr)
+              if (!n.empty ())
               {
-                cerr << "error: opendir() failed for " << d << ": "
-                     << last_errno_msg () << endl;
-                throw failed ();
+                path += '/';
+                path += n;
               }
 
-              for (;;)
-              {
-                errno = 0;
-                if (struct dirent* de = readdir (h.get ()))
-                {
-                  string p (de->d_name);
-                  if (p == "." || p == "..")
-                    continue;
-
-                  ++count;
-
-                  p = d + '/' + p;
-
-                  bool dir (de->d_type == DT_DIR);
-
-                  entry_time et;
-                  if (st != cmd_stat::none)
-                    et = entry_tm (p);
-
-                  if (print != 0)
-                  {
-                    cout << p;
+              entry_info ei;
+              entry_tm_at (AT_FDCWD, path.c_str (), &ei);
+            }
 
-                    if (print > 1)
-                    {
-                      if (st != cmd_stat::none)
-                        cout << " smod " << et.modification << " sacc "
-                             << et.access;
-                    }
+            return bench_clock::elapsed (start_time, bench_clock::now ());
+          };
 
-                    cout << endl;
-                  }
+          vector<nanoseconds> rds (
+            measure (restat,
+                     [&p] () {evict_tree (AT_FDCWD, p.c_str ());}));
 
-                  if (dir)
-                    iterate (p, iterate);
-                }
-                else if (errno == 0)
-                {
-                  // End of stream.
-                  //
-                  h.reset ();
-                  break;
-                }
-                else
-                {
-                  cerr << "error: readdir() failed for " << d << ": "
-                       << last_errno_msg () << endl;
-                  throw failed ();
-                }
-              }
-            };
+          vector<double> rs;
+          for (const nanoseconds& d: rds)
+            rs.push_back (static_cast<double> (d.count ()));
 
-            iterate (p, iterate);
+          nanoseconds rd (llround (sample_stats (move (rs)).median));
 
-            break;
-          }
-        case cmd_iter::none: break;
-        }
+          cerr << "re-stat entries: " << index->size () << endl
+               << "re-stat time: " << rd << endl;
 
-        timestamp end_time (system_clock::now ());
+          if (index->size () != 0)
+            cerr << "re-stat time per entry: " << rd / index->size () << endl;
 
-        if (count == 0)
-        {
-          cerr << "error: no entries in " << p << endl;
-          throw failed ();
+          cerr << "diff to re-stat time ratio: " << fixed << setprecision (2)
+               << static_cast<double> (d.count ()) / rd.count () << endl;
         }
 
-        nanoseconds d (end_time - start_time);
-
-        cerr << "entries: " << count << endl
-             << "full time: " << d << endl
-             << "time per entry: " << d / count << endl;
-
         if (print_result)
           cout << d.count () / count << endl;
 
         break;
       }
-    case cmd::avg:
+    case cmd::gen:
+    case cmd::stats:
+    case cmd::compare:
     case cmd::none: assert (false); break; // Can't be here.
     }
 